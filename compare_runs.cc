@@ -0,0 +1,253 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "stats.h"
+
+// Compares two result sets, e.g. before and after kernel, compiler or allocator change.
+// Result set is a directory with latency_<name>.csv files (desired_throughput latency_ns per line)
+// and optional stats_<name>.csv files (see result_table_t::dump_stats) with actual throughput.
+// Runs with the same <name> (backend, number of queues, ...) are aligned per desired throughput level,
+// latency distributions are compared with Mann-Whitney U test, effect size is Cliff's delta,
+// p99 is judged by the same test on samples above baseline p90.
+
+namespace fs = std::filesystem;
+
+// desired throughput -> latencies
+using run_latencies_t = std::map<size_t, std::vector<double>>;
+// desired throughput -> actual throughput
+using run_throughput_t = std::map<size_t, double>;
+
+run_latencies_t load_latencies(const fs::path& path)
+{
+    run_latencies_t result;
+    std::ifstream f(path);
+    double throughput, latency;
+    while (f >> throughput >> latency) {
+        result[throughput].push_back(latency);
+    }
+    return result;
+}
+
+run_throughput_t load_throughput(const fs::path& path)
+{
+    run_throughput_t result;
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream ss(line);
+        double desired, actual;
+        if (ss >> desired >> actual) {
+            result[desired] = actual;
+        }
+    }
+    return result;
+}
+
+// <name> -> file, for files named <prefix><name>.csv
+std::map<std::string, fs::path> list_runs(const fs::path& dir, const std::string& prefix)
+{
+    std::map<std::string, fs::path> runs;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        std::string filename = entry.path().filename().string();
+        if (filename.rfind(prefix, 0) == 0 && entry.path().extension() == ".csv") {
+            runs[filename.substr(prefix.size(), filename.size() - prefix.size() - 4)] = entry.path();
+        }
+    }
+    return runs;
+}
+
+struct mann_whitney_t
+{
+    // probability of observing such difference if distributions are the same, two-sided
+    double p_value = 1;
+    // Cliff's delta: P(candidate > baseline) - P(candidate < baseline), in [-1, 1]
+    double delta = 0;
+};
+
+// normal approximation with tie correction, fine for samples of tens and more
+mann_whitney_t mann_whitney(const std::vector<double>& baseline, const std::vector<double>& candidate)
+{
+    mann_whitney_t r;
+    size_t n1 = candidate.size();
+    size_t n2 = baseline.size();
+    size_t n = n1 + n2;
+    if (n1 == 0 || n2 == 0) {
+        return r;
+    }
+
+    // (value, is_candidate)
+    std::vector<std::pair<double, bool>> all;
+    all.reserve(n);
+    for (double x : candidate) {
+        all.emplace_back(x, true);
+    }
+    for (double x : baseline) {
+        all.emplace_back(x, false);
+    }
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // sum of candidate ranks, tied values get average rank
+    double rank_sum = 0;
+    double ties = 0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        size_t in_candidate = 0;
+        while (j < n && all[j].first == all[i].first) {
+            in_candidate += all[j].second;
+            j++;
+        }
+        double t = j - i;
+        double avg_rank = (i + 1 + j) / 2.0;
+        rank_sum += avg_rank * in_candidate;
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    double u = rank_sum - n1 * (n1 + 1) / 2.0;
+    double n1n2 = (double)n1 * n2;
+    r.delta = 2 * u / n1n2 - 1;
+
+    double sigma = std::sqrt(n1n2 / 12.0 * ((n + 1) - ties / ((double)n * (n - 1))));
+    if (sigma > 0) {
+        double z = (std::abs(u - n1n2 / 2) - 0.5) / sigma;
+        r.p_value = std::erfc(std::max(0.0, z) / std::sqrt(2.0));
+    }
+    return r;
+}
+
+// values above threshold
+std::vector<double> tail_above(const std::vector<double>& lats, double threshold)
+{
+    std::vector<double> tail;
+    for (double x : lats) {
+        if (x > threshold) {
+            tail.push_back(x);
+        }
+    }
+    return tail;
+}
+
+double relative_change(double base, double cand)
+{
+    return base != 0 ? (cand - base) / base : 0;
+}
+
+int main(int argc, const char* argv[])
+{
+    // compare_runs <baseline_dir> <candidate_dir>
+    //     [alpha=0.01] [min_delta=0.147] [max_p50=0.05] [max_p99=0.10] [max_throughput=0.05]
+    // max_* are allowed relative regressions, exit code is 1 if any of them is exceeded,
+    // 2 on usage error, missing directory or nothing to compare
+    options_t opts(argc, argv);
+    if (opts.positional.size() < 2) {
+        std::cerr << "usage: compare_runs <baseline_dir> <candidate_dir> [alpha=0.01] [min_delta=0.147] "
+                     "[max_p50=0.05] [max_p99=0.10] [max_throughput=0.05]"
+                  << std::endl;
+        return 2;
+    }
+    fs::path baseline_dir = opts.positional[0];
+    fs::path candidate_dir = opts.positional[1];
+    for (const auto& dir : {baseline_dir, candidate_dir}) {
+        if (!fs::is_directory(dir)) {
+            std::cerr << dir.string() << ": not a directory" << std::endl;
+            return 2;
+        }
+    }
+
+    double alpha = opts.get_double("alpha", 0.01);
+    // |delta| >= 0.147 is "small" effect by Romano et al.
+    double min_delta = opts.get_double("min_delta", 0.147);
+    double max_p50 = opts.get_double("max_p50", 0.05);
+    double max_p99 = opts.get_double("max_p99", 0.10);
+    double max_throughput = opts.get_double("max_throughput", 0.05);
+
+    auto baseline_runs = list_runs(baseline_dir, "latency_");
+    auto candidate_runs = list_runs(candidate_dir, "latency_");
+
+    size_t regressions = 0;
+    size_t compared = 0;
+
+    for (const auto& [name, baseline_file] : baseline_runs) {
+        auto it = candidate_runs.find(name);
+        if (it == candidate_runs.end()) {
+            std::cerr << name << ": no candidate run, skipped" << std::endl;
+            continue;
+        }
+        auto base = load_latencies(baseline_file);
+        auto cand = load_latencies(it->second);
+        auto base_thr = load_throughput(baseline_dir / ("stats_" + name + ".csv"));
+        auto cand_thr = load_throughput(candidate_dir / ("stats_" + name + ".csv"));
+
+        printf("\n%s\n", name.c_str());
+        printf("%12s %8s %8s %12s %12s %8s %12s %12s %8s %8s %10s %8s %10s %8s  %s\n", "throughput", "n_base", "n_cand",
+               "p50_base", "p50_cand", "p50_%", "p99_base", "p99_cand", "p99_%", "delta", "p_value", "tail_d", "tail_p", "thr_%",
+               "verdict");
+
+        for (auto& [level, base_lats] : base) {
+            auto c = cand.find(level);
+            if (c == cand.end()) {
+                continue;
+            }
+            auto& cand_lats = c->second;
+            compared++;
+
+            auto mw = mann_whitney(base_lats, cand_lats);
+            auto bs = calc_latency_stats(base_lats);
+            auto cs = calc_latency_stats(cand_lats);
+            double p50_change = relative_change(bs.p50, cs.p50);
+            double p99_change = relative_change(bs.p99, cs.p99);
+            // change confined to the tail doesn't move whole distribution test,
+            // so p99 is judged by the same test on samples above baseline p90
+            auto tail = mann_whitney(tail_above(base_lats, bs.p90), tail_above(cand_lats, bs.p90));
+
+            bool has_thr = base_thr.count(level) && cand_thr.count(level);
+            double thr_change = has_thr ? relative_change(base_thr[level], cand_thr[level]) : 0;
+
+            // latency regression must be both significant and large enough to matter
+            bool significant = mw.p_value < alpha && std::abs(mw.delta) >= min_delta;
+            bool p50_regression = significant && mw.delta > 0 && p50_change > max_p50;
+            bool p99_regression = tail.p_value < alpha && tail.delta > 0 && p99_change > max_p99;
+            std::string verdict;
+            if (p50_regression || p99_regression) {
+                verdict += "LATENCY_REGRESSION ";
+            } else if (significant && mw.delta < 0) {
+                verdict += "improved ";
+            }
+            if (has_thr && -thr_change > max_throughput) {
+                verdict += "THROUGHPUT_REGRESSION ";
+            }
+            if (verdict.find("REGRESSION") != std::string::npos) {
+                regressions++;
+            }
+
+            printf("%12zu %8zu %8zu %12.0f %12.0f %8.1f %12.0f %12.0f %8.1f %8.3f %10.2e %8.3f %10.2e %8s  %s\n",
+                   level, base_lats.size(), cand_lats.size(), bs.p50, cs.p50, p50_change * 100, bs.p99, cs.p99,
+                   p99_change * 100, mw.delta, mw.p_value, tail.delta, tail.p_value,
+                   has_thr ? std::to_string((int)std::round(thr_change * 100)).c_str() : "-", verdict.c_str());
+        }
+    }
+    for (const auto& [name, _] : candidate_runs) {
+        if (baseline_runs.count(name) == 0) {
+            std::cerr << name << ": no baseline run, skipped" << std::endl;
+        }
+    }
+
+    printf("\ncompared %zu levels, %zu regressions\n", compared, regressions);
+    // nothing to compare is a misconfigured gate, not a pass
+    if (compared == 0) {
+        std::cerr << "no matching latency_<name>.csv levels in " << baseline_dir.string() << " and "
+                  << candidate_dir.string() << std::endl;
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
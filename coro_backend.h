@@ -0,0 +1,385 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "deadline.h"
+#include "pipeline.h"
+#include "queue_monitor.h"
+
+// Stackless C++20 coroutines on a minimal single-thread scheduler:
+// ready queue of resumable coroutines and timer queue for sleeping ones.
+// Stages can't use run_blocking_pipeline() because every blocking call is co_await,
+// so coroutine versions of producer, pipe and consumer are here, sharing stage logic from pipeline.h.
+struct coro_scheduler_t
+{
+    struct timer_t
+    {
+        hr_clock::time_point wake_at;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const timer_t& other) const
+        {
+            return wake_at > other.wake_at;
+        }
+    };
+
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<timer_t, std::vector<timer_t>, std::greater<timer_t>> timers;
+
+    void schedule(std::coroutine_handle<> h)
+    {
+        ready.push_back(h);
+    }
+
+    // runs until there are no ready and sleeping coroutines
+    void run()
+    {
+        while (!ready.empty() || !timers.empty()) {
+            if (!timers.empty()) {
+                auto now = hr_clock::now();
+                while (!timers.empty() && timers.top().wake_at <= now) {
+                    ready.push_back(timers.top().handle);
+                    timers.pop();
+                }
+                if (ready.empty()) {
+                    std::this_thread::sleep_until(timers.top().wake_at);
+                    continue;
+                }
+            }
+            auto h = ready.front();
+            ready.pop_front();
+            h.resume();
+        }
+    }
+
+    struct yield_awaiter
+    {
+        coro_scheduler_t& sched;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            sched.schedule(h);
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    struct sleep_awaiter
+    {
+        coro_scheduler_t& sched;
+        hr_clock::time_point wake_at;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            sched.timers.push({wake_at, h});
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    yield_awaiter yield()
+    {
+        return {*this};
+    }
+
+    sleep_awaiter sleep_for(std::chrono::nanoseconds ns)
+    {
+        return {*this, hr_clock::now() + ns};
+    }
+};
+
+// Fire-and-forget coroutine, starts when scheduler picks it up, frame is destroyed on completion
+struct coro_task_t
+{
+    struct promise_type
+    {
+        coro_task_t get_return_object()
+        {
+            return {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() { }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Bounded channel, blocked sender or receiver is resumed by the other side with direct hand-off
+struct coro_channel_t
+{
+    struct waiter_t
+    {
+        std::coroutine_handle<> handle;
+        msg_t* msg;
+    };
+
+    coro_scheduler_t& sched;
+    size_t capacity;
+    std::deque<msg_t> buffer;
+    std::deque<waiter_t> senders;
+    std::deque<waiter_t> receivers;
+    queue_counters_t counters;
+    deadline_filter_t filter;
+
+    coro_channel_t(coro_scheduler_t& scheduler, size_t channel_capacity)
+        : sched(scheduler)
+        , capacity(channel_capacity)
+    { }
+
+    bool try_send(msg_t& msg)
+    {
+        if (!receivers.empty()) {
+            waiter_t r = receivers.front();
+            receivers.pop_front();
+            *r.msg = msg;
+            counters.on_enqueue();
+            counters.on_dequeue();
+            sched.schedule(r.handle);
+            return true;
+        }
+        if (buffer.size() < capacity) {
+            buffer.push_back(msg);
+            counters.on_enqueue();
+            return true;
+        }
+        return false;
+    }
+
+    bool try_recv(msg_t& msg)
+    {
+        if (buffer.empty()) {
+            return false;
+        }
+        msg = buffer.front();
+        buffer.pop_front();
+        counters.on_dequeue();
+        if (!senders.empty()) {
+            // free slot goes to the first blocked sender
+            waiter_t s = senders.front();
+            senders.pop_front();
+            buffer.push_back(*s.msg);
+            counters.on_enqueue();
+            sched.schedule(s.handle);
+        }
+        return true;
+    }
+
+    struct send_awaiter
+    {
+        coro_channel_t& ch;
+        msg_t msg;
+
+        bool await_ready()
+        {
+            if (deadline_policy.needs_enqueue_timestamp()) {
+                msg.set_enqueue_timestamp(hr_clock::now());
+            }
+            return ch.try_send(msg);
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            ch.senders.push_back({h, &msg});
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    struct recv_awaiter
+    {
+        coro_channel_t& ch;
+        msg_t msg;
+
+        bool await_ready()
+        {
+            return ch.try_recv(msg);
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            ch.receivers.push_back({h, &msg});
+        }
+
+        msg_t await_resume() const noexcept
+        {
+            return msg;
+        }
+    };
+
+    send_awaiter send(const msg_t& msg)
+    {
+        return {*this, msg};
+    }
+
+    // expired frames must be shed by caller with filter
+    recv_awaiter recv()
+    {
+        return {*this, {}};
+    }
+};
+
+struct coro_backend
+{
+    using queue = coro_channel_t;
+
+    static constexpr bool produce_batches = true;
+
+    // same pacing as fibers: yields instead of sleeps for high throughput
+    struct pacer
+    {
+        coro_scheduler_t& sched;
+        size_t skipped_yields = 0;
+
+        // returns true if coroutine should co_await sched.yield() or sched.sleep_for(ns)
+        bool should_suspend(std::chrono::nanoseconds ns)
+        {
+            using namespace std::chrono_literals;
+            if (ns > 1us) {
+                return true;
+            }
+            if constexpr (produce_batches) {
+                size_t to_skip = 10'000 / (ns.count() + 1);
+                if (skipped_yields++ >= to_skip) {
+                    skipped_yields = 0;
+                    return true;
+                }
+                return false;
+            }
+            return true;
+        }
+    };
+
+    const bench_config_t& cfg;
+    coro_scheduler_t sched;
+
+    coro_backend(const bench_config_t& config)
+        : cfg(config)
+    {
+        std::cerr << "backend: coro" << std::endl;
+    }
+
+    std::shared_ptr<queue> make_queue()
+    {
+        return std::make_shared<queue>(sched, cfg.queue_capacity);
+    }
+
+    template<typename Task>
+    void spawn(Task task)
+    {
+        sched.schedule(task.handle);
+    }
+
+    static coro_task_t producer(coro_scheduler_t& sched, std::shared_ptr<queue> sink, const rate_schedule_t& schedule)
+    {
+        using namespace std::chrono_literals;
+        pacer p{sched};
+        for (size_t level = 0; level < schedule.rates.size(); level++) {
+            producer_batch_t batch(schedule.rates[level], schedule);
+            msg_t msg;
+            while (batch.next(msg)) {
+                co_await sink->send(msg);
+                if (p.should_suspend(batch.delay)) {
+                    if (batch.delay > 1us) {
+                        co_await sched.sleep_for(batch.delay);
+                    } else {
+                        co_await sched.yield();
+                    }
+                }
+            }
+            co_await sink->send(batch.end());
+            co_await sched.sleep_for(schedule.pause_after_level(level));
+        }
+        co_await sched.sleep_for(schedule.finish_delay);
+        co_await sink->send(finish_msg());
+        std::cerr << "prod exit" << std::endl;
+    }
+
+    static coro_task_t consumer(std::shared_ptr<queue> src)
+    {
+        consumer_stage_t consumer;
+        while (true) {
+            msg_t msg = co_await src->recv();
+            if (src->filter.shed(msg)) {
+                continue;
+            }
+            if (consumer.on_msg(msg)) {
+                break;
+            }
+        }
+        std::cerr << "cons exit" << std::endl;
+    }
+
+    static coro_task_t pipe(std::shared_ptr<queue> src, std::shared_ptr<queue> sink)
+    {
+        while (true) {
+            msg_t msg = co_await src->recv();
+            if (src->filter.shed(msg)) {
+                continue;
+            }
+            co_await sink->send(msg);
+            if (msg.type == FrameType::FINISH) {
+                break;
+            }
+        }
+        std::cerr << "pipe exit" << std::endl;
+    }
+
+    void run_pipeline()
+    {
+        auto q1 = make_queue();
+        spawn(consumer(q1));
+
+        std::shared_ptr<queue> sink = q1;
+        std::vector<const queue_counters_t*> stages{&q1->counters};
+        for (int i = 0; i < cfg.n_queues - 1; i++) {
+            auto src = make_queue();
+            spawn(pipe(src, sink));
+            sink = src;
+            stages.push_back(&src->counters);
+        }
+        std::reverse(stages.begin(), stages.end());
+
+        start_instruments(cfg, stages);
+        // after instruments, their threads must not inherit the pin
+        affinity_guard_t guard;
+        pin_current_thread(cfg.cpu_for(0));
+
+        spawn(producer(sched, sink, cfg.schedule));
+        sched.run();
+
+        stop_instruments();
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "options.h"
+
+// Deadline-aware queues: producer stamps every timed message with budget, deadline = create_timestamp + budget,
+// queues shed frames on dequeue according to policy:
+//  - drop: frame is dropped if its deadline has passed,
+//  - codel: CoDel control of per-queue sojourn time (RFC 8289), drops frames while
+//    sojourn time stays above target for longer than interval.
+// Only timed messages can be dropped, never BATCH_END, FINISH or BARE_MSG frames.
+struct deadline_policy_t
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    enum mode_t
+    {
+        NONE,
+        DROP,
+        CODEL
+    };
+
+    mode_t mode = NONE;
+    // 0 - messages have no deadline
+    std::chrono::nanoseconds budget{0};
+    std::chrono::nanoseconds codel_target = std::chrono::milliseconds(5);
+    std::chrono::nanoseconds codel_interval = std::chrono::milliseconds(100);
+
+    // dropped frames of all queues
+    std::atomic<uint64_t> dropped{0};
+
+    // [deadline_us=N] [shed=drop|codel] [codel_target_us=5000] [codel_interval_us=100000]
+    // shed=drop works only with deadline_us
+    void configure(const options_t& opts)
+    {
+        budget = std::chrono::microseconds(opts.get_int("deadline_us", 0));
+        std::string shed = opts.get("shed", "none");
+        mode = shed == "drop" ? DROP : shed == "codel" ? CODEL : NONE;
+        codel_target = std::chrono::microseconds(opts.get_int("codel_target_us", 5000));
+        codel_interval = std::chrono::microseconds(opts.get_int("codel_interval_us", 100'000));
+    }
+
+    // 0 - no deadline
+    uint32_t budget_us() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(budget).count();
+    }
+
+    bool needs_enqueue_timestamp() const
+    {
+        return mode == CODEL;
+    }
+};
+
+inline deadline_policy_t deadline_policy;
+
+// Per-queue shedding state, used only by the queue's receiver
+struct deadline_filter_t
+{
+    using clock = deadline_policy_t::clock;
+
+    // CoDel state
+    clock::time_point first_above_time{};
+    clock::time_point drop_next{};
+    uint32_t count = 0;
+    uint32_t last_count = 0;
+    bool dropping = false;
+
+    // Frame must have deadline(), enqueue_timestamp() and sheddable() methods.
+    // Returns true if frame should be dropped.
+    template<typename Frame>
+    bool shed(const Frame& x)
+    {
+        const deadline_policy_t& p = deadline_policy;
+        if (p.mode == deadline_policy_t::NONE || !x.sheddable()) {
+            return false;
+        }
+        auto now = clock::now();
+        bool drop = false;
+        if (p.mode == deadline_policy_t::DROP) {
+            auto deadline = x.deadline();
+            drop = deadline != clock::time_point{} && now > deadline;
+        } else {
+            drop = codel_drop(now - x.enqueue_timestamp(), now);
+        }
+        if (drop) {
+            deadline_policy.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return drop;
+    }
+
+    std::chrono::nanoseconds control_law(uint32_t n) const
+    {
+        return std::chrono::nanoseconds((int64_t)(deadline_policy.codel_interval.count() / std::sqrt((double)n)));
+    }
+
+    bool codel_drop(clock::duration sojourn, clock::time_point now)
+    {
+        const deadline_policy_t& p = deadline_policy;
+
+        bool ok_to_drop = false;
+        if (sojourn < p.codel_target) {
+            first_above_time = {};
+        } else if (first_above_time == clock::time_point{}) {
+            first_above_time = now + p.codel_interval;
+        } else if (now >= first_above_time) {
+            ok_to_drop = true;
+        }
+
+        if (dropping) {
+            if (!ok_to_drop) {
+                dropping = false;
+                return false;
+            }
+            if (now >= drop_next) {
+                count++;
+                drop_next += control_law(count);
+                return true;
+            }
+            return false;
+        }
+        if (ok_to_drop) {
+            dropping = true;
+            // resume with previous drop rate if recently was in dropping state
+            uint32_t delta = count - last_count;
+            count = (delta > 1 && now - drop_next < 16 * p.codel_interval) ? delta : 1;
+            drop_next = now + control_law(count);
+            last_count = count;
+            return true;
+        }
+        return false;
+    }
+};
+
+// Consumer side: counts messages delivered before their deadline during a batch
+struct deadline_counter_t
+{
+    using clock = deadline_policy_t::clock;
+
+    size_t timed = 0;
+    size_t on_time = 0;
+    uint64_t dropped_before = deadline_policy.dropped.load(std::memory_order_relaxed);
+
+    void on_msg(clock::time_point deadline, clock::time_point now)
+    {
+        timed++;
+        if (deadline == clock::time_point{} || now <= deadline) {
+            on_time++;
+        }
+    }
+
+    // on-time messages per second out of delivered throughput,
+    // estimated from timed messages when sampling, resets counters
+    double goodput(double throughput)
+    {
+        double g = timed > 0 ? throughput * on_time / timed : throughput;
+        timed = 0;
+        on_time = 0;
+        return g;
+    }
+
+    // frames dropped by all queues since previous call
+    uint64_t take_dropped()
+    {
+        uint64_t dropped = deadline_policy.dropped.load(std::memory_order_relaxed);
+        uint64_t result = dropped - dropped_before;
+        dropped_before = dropped;
+        return result;
+    }
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <boost/fiber/all.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "deadline.h"
+#include "options.h"
+#include "pipeline.h"
+#include "queue_monitor.h"
+#include "select.h"
+
+// Every stage is a boost fiber, queues are buffered channels.
+// With fiber_threads > 1 fibers are executed by pool of threads with work_stealing or shared_work scheduler,
+// otherwise all fibers are executed by the main thread.
+struct fiber_backend
+{
+    using wakeup_type = wakeup_t<boost::fibers::mutex, boost::fibers::condition_variable>;
+
+    struct queue
+    {
+        boost::fibers::buffered_channel<msg_t> channel;
+        queue_counters_t counters;
+        deadline_filter_t filter;
+        // set by selector_t, notified after every push
+        wakeup_type* wakeup = nullptr;
+
+        queue(size_t capacity)
+            : channel(capacity)
+        { }
+
+        // non-blocking recv, for selector_t
+        bool try_recv(msg_t& msg)
+        {
+            while (channel.try_pop(msg) == boost::fibers::channel_op_status::success) {
+                counters.on_dequeue();
+                if (!filter.shed(msg)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    using selector = selector_t<queue, wakeup_type>;
+
+    static constexpr bool produce_batches = true;
+
+    struct pacer
+    {
+        size_t skipped_yields = 0;
+
+        void wait(std::chrono::nanoseconds ns)
+        {
+            using namespace std::chrono_literals;
+            if (ns <= 1us) {
+                // throuhgput >= 1M obj/s
+                if constexpr (produce_batches) {
+                    // should act like batch processing
+                    // 100k batches/s
+                    size_t to_skip = 10'000 / (ns.count() + 1);
+                    if (skipped_yields++ >= to_skip) {
+                        skipped_yields = 0;
+                        boost::this_fiber::yield();
+                    }
+                } else {
+                    boost::this_fiber::yield();
+                }
+            } else {
+                boost::this_fiber::sleep_for(ns);
+            }
+        }
+    };
+
+    const bench_config_t& cfg;
+    unsigned int thread_count;
+    std::string scheduler;
+
+    std::vector<boost::fibers::fiber> fibers;
+    std::vector<std::thread> worker_threads;
+    bool done = false;
+    std::mutex worker_threads_mutex;
+    boost::fibers::condition_variable_any worker_threads_cv;
+
+    // [fiber_threads=<hardware concurrency>] [scheduler=work_stealing|shared_work]
+    fiber_backend(const bench_config_t& config, const options_t& opts)
+        : cfg(config)
+        , thread_count(opts.get_int("fiber_threads", std::thread::hardware_concurrency()))
+        , scheduler(opts.get("scheduler", "work_stealing"))
+    {
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+        std::cerr << "backend: fibers, threads: " << thread_count << ", scheduler: " << scheduler
+                  << ", channel capacity: " << channel_capacity(cfg.queue_capacity) << std::endl;
+    }
+
+    // buffered_channel requires power of 2 capacity, at least 2
+    static size_t channel_capacity(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    std::shared_ptr<queue> make_queue()
+    {
+        return std::make_shared<queue>(channel_capacity(cfg.queue_capacity));
+    }
+
+    static void send(queue& q, msg_t msg)
+    {
+        using namespace std::chrono_literals;
+        if (deadline_policy.needs_enqueue_timestamp()) {
+            msg.set_enqueue_timestamp(hr_clock::now());
+        }
+        while (true) {
+            auto channel_state = q.channel.push(msg);
+            switch (channel_state) {
+            case boost::fibers::channel_op_status::success:
+                q.counters.on_enqueue();
+                if (q.wakeup) {
+                    q.wakeup->notify();
+                }
+                return;
+            case boost::fibers::channel_op_status::full:
+            case boost::fibers::channel_op_status::timeout:
+                boost::this_fiber::yield();
+                continue;
+            case boost::fibers::channel_op_status::closed:
+                printf("FATAL: channel closed\n");
+            default:
+                printf("FATAL: channel unexpected state\n");
+            }
+            std::this_thread::sleep_for(1s);
+            std::terminate();
+        }
+    }
+
+    static msg_t recv(queue& q)
+    {
+        using namespace std::chrono_literals;
+        msg_t msg;
+        while (true) {
+            auto channel_state = q.channel.pop(msg);
+            switch (channel_state) {
+            case boost::fibers::channel_op_status::success:
+                q.counters.on_dequeue();
+                if (q.filter.shed(msg)) {
+                    continue;
+                }
+                return msg;
+            case boost::fibers::channel_op_status::empty:
+            case boost::fibers::channel_op_status::timeout:
+                boost::this_fiber::yield();
+                continue;
+            case boost::fibers::channel_op_status::closed:
+                printf("FATAL: channel closed\n");
+            default:
+                printf("FATAL: channel unexpected state\n");
+            }
+            std::this_thread::sleep_for(1s);
+            std::terminate();
+        }
+    }
+
+    static void sleep_for(std::chrono::nanoseconds ns)
+    {
+        boost::this_fiber::sleep_for(ns);
+    }
+
+    template<typename F>
+    void spawn(F&& f)
+    {
+        fibers.emplace_back(std::forward<F>(f));
+    }
+
+    void use_scheduler()
+    {
+        // thread registers itself at scheduler
+        if (scheduler == "shared_work") {
+            boost::fibers::use_scheduling_algorithm<boost::fibers::algo::shared_work>();
+        } else {
+            boost::fibers::use_scheduling_algorithm<boost::fibers::algo::work_stealing>(thread_count);
+        }
+    }
+
+    void worker(int id)
+    {
+        pin_current_thread(cfg.cpu_for(id));
+        use_scheduler();
+
+        std::unique_lock<std::mutex> lock(worker_threads_mutex);
+        worker_threads_cv.wait(lock, [this]() { return done; });
+
+        printf("Exit worker thread %d function\n", id);
+    }
+
+    void start_scheduler_threads()
+    {
+        for (unsigned int i = 1; i < thread_count; i++) {
+            worker_threads.emplace_back([this, i]() { worker(i); });
+        }
+    }
+
+    void stop_scheduler_threads()
+    {
+        std::unique_lock<std::mutex> lock(worker_threads_mutex);
+        done = true;
+        lock.unlock();
+        worker_threads_cv.notify_all();
+
+        for (auto& t : worker_threads) {
+            t.join();
+        }
+        worker_threads.clear();
+    }
+
+    void run()
+    {
+        affinity_guard_t guard;
+        pin_current_thread(cfg.cpu_for(0));
+        if (thread_count > 1) {
+            // consumer is the first fiber, it exits last
+            for (size_t i = 1; i < fibers.size(); i++) {
+                fibers[i].detach();
+            }
+            start_scheduler_threads();
+            use_scheduler();
+            fibers[0].join();
+            stop_scheduler_threads();
+        } else {
+            // execute all fibers in the single main thread
+            for (auto it = fibers.rbegin(); it != fibers.rend(); ++it) {
+                it->join();
+            }
+        }
+        fibers.clear();
+    }
+};
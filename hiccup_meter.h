@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "options.h"
+
+// Histogram with power-of-2 buckets: bucket i holds values in [2^i, 2^(i+1)) ns
+struct log2_histogram_t
+{
+    std::array<uint64_t, 64> buckets{};
+    uint64_t count = 0;
+    double sum = 0;
+    uint64_t max = 0;
+
+    void record(uint64_t ns)
+    {
+        size_t i = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+        buckets[i]++;
+        count++;
+        sum += ns;
+        max = std::max(max, ns);
+    }
+
+    // upper bound of bucket containing q-th quantile
+    uint64_t quantile(double q) const
+    {
+        uint64_t rank = q * count;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return std::min<uint64_t>(max, (2ull << i) - 1);
+            }
+        }
+        return max;
+    }
+};
+
+// Per-CPU frequency and governor as seen in sysfs during one throughput level
+struct cpu_freq_t
+{
+    std::string governor;
+    uint64_t min_khz = 0;
+    uint64_t max_khz = 0;
+    double sum_khz = 0;
+    size_t samples = 0;
+};
+
+// Thread which measures platform noise while benchmark is running:
+//  - sleep mode: sleeps for interval and records how late it wakes up,
+//  - spin mode: reads clock in a tight loop and records gaps between reads,
+//    it occupies the whole core, so pin it with hiccup_cpu=N away from benchmark threads.
+// Lateness is recorded into histogram of current desired throughput level.
+// Also samples scaling_governor and scaling_cur_freq of benchmark CPUs (affinity= and hiccup_cpu=),
+// or of every CPU in process affinity mask if benchmark is not pinned.
+struct hiccup_meter_t
+{
+    enum mode_t
+    {
+        SLEEP,
+        SPIN
+    };
+
+    mode_t mode = SLEEP;
+    std::chrono::nanoseconds interval = std::chrono::milliseconds(1);
+    std::chrono::nanoseconds freq_interval = std::chrono::milliseconds(100);
+    int cpu = -1;
+
+    std::atomic<double> desired_throughput{0};
+    std::atomic<bool> stopped{false};
+    std::thread meter;
+
+    // accessed only by meter thread until stop()
+    std::map<double, log2_histogram_t> hiccups;
+    std::map<double, std::map<int, cpu_freq_t>> freqs;
+    std::vector<int> cpus;
+    // CPUs from affinity=, empty - not pinned
+    std::vector<int> pinned_cpus;
+
+    // hiccups=file platform=file [hiccup_mode=sleep|spin] [hiccup_interval_us=1000] [hiccup_cpu=N] [affinity=0,1,2]
+    std::string hiccups_filename;
+    std::string platform_filename;
+
+    void configure(const options_t& opts)
+    {
+        hiccups_filename = opts.get("hiccups", "");
+        platform_filename = opts.get("platform", "");
+        mode = opts.get("hiccup_mode", "sleep") == "spin" ? SPIN : SLEEP;
+        interval = std::chrono::microseconds(opts.get_int("hiccup_interval_us", 1000));
+        cpu = opts.get_int("hiccup_cpu", -1);
+        pinned_cpus.clear();
+        for (long c : opts.get_int_list("affinity", {})) {
+            pinned_cpus.push_back(c);
+        }
+    }
+
+    bool requested() const
+    {
+        return !hiccups_filename.empty() || !platform_filename.empty();
+    }
+
+    void set_throughput(double throughput)
+    {
+        desired_throughput.store(throughput, std::memory_order_relaxed);
+    }
+
+    bool enabled() const
+    {
+        return meter.joinable();
+    }
+
+    void start()
+    {
+        if (pinned_cpus.empty()) {
+            cpus = affinity_cpus();
+        } else {
+            cpus = pinned_cpus;
+            if (cpu >= 0) {
+                cpus.push_back(cpu);
+            }
+            std::sort(cpus.begin(), cpus.end());
+            cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        }
+        stopped = false;
+        meter = std::thread([this]() { run(); });
+    }
+
+    void stop()
+    {
+        if (!meter.joinable()) {
+            return;
+        }
+        stopped = true;
+        meter.join();
+    }
+
+    static std::vector<int> affinity_cpus()
+    {
+        std::vector<int> result;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int i = 0; i < CPU_SETSIZE; i++) {
+                if (CPU_ISSET(i, &set)) {
+                    result.push_back(i);
+                }
+            }
+        }
+        return result;
+    }
+
+    static std::string read_sysfs(int cpu, const char* name)
+    {
+        std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/" + name);
+        std::string value;
+        f >> value;
+        return value;
+    }
+
+    void sample_freqs(double throughput)
+    {
+        auto& level = freqs[throughput];
+        for (int c : cpus) {
+            auto& f = level[c];
+            if (f.governor.empty()) {
+                f.governor = read_sysfs(c, "scaling_governor");
+                if (f.governor.empty()) {
+                    f.governor = "n/a";
+                }
+            }
+            uint64_t khz = strtoull(read_sysfs(c, "scaling_cur_freq").c_str(), 0, 10);
+            if (khz == 0) {
+                continue;
+            }
+            f.min_khz = f.samples == 0 ? khz : std::min(f.min_khz, khz);
+            f.max_khz = std::max(f.max_khz, khz);
+            f.sum_khz += khz;
+            f.samples++;
+        }
+    }
+
+    void run()
+    {
+        using clock = std::chrono::steady_clock;
+
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+        double throughput = desired_throughput.load(std::memory_order_relaxed);
+        log2_histogram_t* hist = &hiccups[throughput];
+        sample_freqs(throughput);
+        auto next_freq_sample = clock::now() + freq_interval;
+
+        auto prev = clock::now();
+        while (!stopped.load(std::memory_order_relaxed)) {
+            if (mode == SLEEP) {
+                std::this_thread::sleep_for(interval);
+            }
+            auto now = clock::now();
+            auto late = now - prev;
+            if (mode == SLEEP) {
+                late -= interval;
+            }
+            hist->record(std::max<int64_t>(0, std::chrono::nanoseconds(late).count()));
+
+            double t = desired_throughput.load(std::memory_order_relaxed);
+            if (t != throughput) {
+                throughput = t;
+                hist = &hiccups[throughput];
+                sample_freqs(throughput);
+                next_freq_sample = now + freq_interval;
+            } else if (now >= next_freq_sample) {
+                sample_freqs(throughput);
+                next_freq_sample = now + freq_interval;
+            }
+            // don't count own bookkeeping as platform noise
+            prev = clock::now();
+        }
+    }
+
+    // hiccups file: desired_throughput bucket_upper_ns count
+    // platform file: desired_throughput cpu governor min_khz mean_khz max_khz
+    void dump() const
+    {
+        if (!hiccups_filename.empty()) {
+            std::ofstream of(hiccups_filename);
+            std::cerr << "save hiccups to " << hiccups_filename << std::endl;
+            fprintf(stderr, "%12s %10s %10s %10s %10s %12s\n", "throughput", "samples", "mean_ns", "p99_ns",
+                    "p999_ns", "max_ns");
+            for (const auto& [throughput, h] : hiccups) {
+                for (size_t i = 0; i < h.buckets.size(); i++) {
+                    if (h.buckets[i] > 0) {
+                        of << throughput << " " << (2ull << i) - 1 << " " << h.buckets[i] << std::endl;
+                    }
+                }
+                fprintf(stderr, "%12.0f %10lu %10.0f %10lu %10lu %12lu\n", throughput, h.count,
+                        h.count ? h.sum / h.count : 0, h.quantile(0.99), h.quantile(0.999), h.max);
+            }
+        }
+        if (!platform_filename.empty()) {
+            std::ofstream of(platform_filename);
+            std::cerr << "save cpu frequencies to " << platform_filename << std::endl;
+            for (const auto& [throughput, level] : freqs) {
+                for (const auto& [c, f] : level) {
+                    of << throughput << " " << c << " " << f.governor << " " << f.min_khz << " "
+                       << (f.samples ? f.sum_khz / f.samples : 0) << " " << f.max_khz << std::endl;
+                }
+            }
+        }
+    }
+};
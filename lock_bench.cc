@@ -0,0 +1,209 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "locks.h"
+#include "options.h"
+
+using namespace std::chrono_literals;
+using hr_clock = std::chrono::high_resolution_clock;
+
+// Contention microbenchmark: N threads acquire the same lock in a loop,
+// do cs_len units of work inside and outside_len units outside of critical section.
+
+void busy_work(size_t units)
+{
+    volatile size_t counter = units;
+    while (counter) {
+        counter = counter - 1;
+    }
+}
+
+struct alignas(64) thread_stat_t
+{
+    size_t acquisitions = 0;
+    size_t handoffs = 0;
+    double handoff_sum_ns = 0;
+    double handoff_max_ns = 0;
+};
+
+struct contention_result_t
+{
+    std::string lock;
+    size_t threads;
+    size_t cs_len;
+    double throughput;
+    size_t min_acquisitions;
+    size_t max_acquisitions;
+    // coefficient of variation of per-thread acquisitions, 0 - perfectly fair
+    double acquisitions_cov;
+    double handoff_mean_ns;
+    double handoff_max_ns;
+};
+
+template<typename Lock>
+contention_result_t run_contention(size_t n_threads, size_t cs_len, size_t outside_len, std::chrono::milliseconds duration)
+{
+    Lock lock;
+
+    // protected by lock
+    volatile size_t shared_counter = 0;
+    int last_owner = -1;
+    hr_clock::time_point released_at;
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopped{false};
+    std::vector<thread_stat_t> stats(n_threads);
+
+    auto worker = [&](int id) {
+        thread_stat_t& stat = stats[id];
+        while (!started.load(std::memory_order_acquire)) {
+            cpu_pause();
+        }
+        while (!stopped.load(std::memory_order_relaxed)) {
+            lock.lock();
+            if (last_owner >= 0 && last_owner != id) {
+                // time from release by other thread to acquisition by this one
+                std::chrono::duration<double, std::nano> handoff = hr_clock::now() - released_at;
+                stat.handoffs++;
+                stat.handoff_sum_ns += handoff.count();
+                stat.handoff_max_ns = std::max(stat.handoff_max_ns, handoff.count());
+            }
+            for (size_t i = 0; i < cs_len; i++) {
+                shared_counter = shared_counter + 1;
+            }
+            stat.acquisitions++;
+            last_owner = id;
+            released_at = hr_clock::now();
+            lock.unlock();
+            busy_work(outside_len);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n_threads; i++) {
+        threads.emplace_back(worker, i);
+    }
+
+    auto start = hr_clock::now();
+    started.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stopped.store(true, std::memory_order_relaxed);
+    for (auto& t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = hr_clock::now() - start;
+
+    contention_result_t r{lock_name<Lock>, n_threads, cs_len};
+
+    size_t total = 0;
+    size_t handoffs = 0;
+    double handoff_sum = 0;
+    r.min_acquisitions = stats[0].acquisitions;
+    r.max_acquisitions = 0;
+    r.handoff_max_ns = 0;
+    for (const auto& s : stats) {
+        total += s.acquisitions;
+        handoffs += s.handoffs;
+        handoff_sum += s.handoff_sum_ns;
+        r.min_acquisitions = std::min(r.min_acquisitions, s.acquisitions);
+        r.max_acquisitions = std::max(r.max_acquisitions, s.acquisitions);
+        r.handoff_max_ns = std::max(r.handoff_max_ns, s.handoff_max_ns);
+    }
+    double mean = (double)total / n_threads;
+    double var = 0;
+    for (const auto& s : stats) {
+        var += (s.acquisitions - mean) * (s.acquisitions - mean);
+    }
+    r.acquisitions_cov = mean > 0 ? std::sqrt(var / n_threads) / mean : 0;
+    r.throughput = total / elapsed.count();
+    r.handoff_mean_ns = handoffs > 0 ? handoff_sum / handoffs : 0;
+    return r;
+}
+
+std::vector<long> default_thread_counts()
+{
+    std::vector<long> counts;
+    // hardware_concurrency() is 0 if unknown
+    long hw = std::max<long>(1, std::thread::hardware_concurrency());
+    for (long n = 1; n < hw; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(hw);
+    return counts;
+}
+
+int main(int argc, const char* argv[])
+{
+    // lock_bench [results_file] [lock=name] [threads=1,2,4] [cs=0,10,100,1000] [outside=100] [duration_ms=200]
+    options_t opts(argc, argv);
+
+    std::vector<long> thread_counts;
+    for (long n : opts.get_int_list("threads", default_thread_counts())) {
+        if (n > 0) {
+            thread_counts.push_back(n);
+        }
+    }
+    // empty critical section (cs=0) is valid, negative lengths would wrap around
+    std::vector<long> cs_lens;
+    for (long cs_len : opts.get_int_list("cs", {0, 10, 100, 1000})) {
+        if (cs_len >= 0) {
+            cs_lens.push_back(cs_len);
+        }
+    }
+    long outside = opts.get_int("outside", 100);
+    if (outside < 0) {
+        std::cerr << "outside must not be negative: " << outside << std::endl;
+        return 2;
+    }
+    size_t outside_len = outside;
+    std::chrono::milliseconds duration = 1ms * opts.get_int("duration_ms", 200);
+    std::string only_lock = opts.get("lock", "");
+
+    std::unique_ptr<std::ofstream> of;
+    if (!opts.positional.empty()) {
+        of = std::make_unique<std::ofstream>(opts.positional[0]);
+        std::cerr << "save results to " << opts.positional[0] << std::endl;
+        *of << "# lock threads cs_len throughput_ops_s min_acq max_acq acq_cov handoff_mean_ns handoff_max_ns"
+            << std::endl;
+    }
+
+    printf("%-14s %7s %6s %14s %10s %10s %8s %12s %12s\n", "lock", "threads", "cs", "ops/s", "min_acq", "max_acq",
+           "acq_cov", "handoff_ns", "handoff_max");
+
+    bool found = false;
+    for_each_lock_type([&](auto tag) {
+        using Lock = typename decltype(tag)::type;
+        if (!only_lock.empty() && only_lock != lock_name<Lock>) {
+            return;
+        }
+        found = true;
+        for (long n_threads : thread_counts) {
+            for (long cs_len : cs_lens) {
+                auto r = run_contention<Lock>(n_threads, cs_len, outside_len, duration);
+                printf("%-14s %7zu %6zu %14.0f %10zu %10zu %8.3f %12.1f %12.1f\n", r.lock.c_str(), r.threads, r.cs_len,
+                       r.throughput, r.min_acquisitions, r.max_acquisitions, r.acquisitions_cov, r.handoff_mean_ns,
+                       r.handoff_max_ns);
+                if (of) {
+                    *of << r.lock << " " << r.threads << " " << r.cs_len << " " << r.throughput << " "
+                        << r.min_acquisitions << " " << r.max_acquisitions << " " << r.acquisitions_cov << " "
+                        << r.handoff_mean_ns << " " << r.handoff_max_ns << std::endl;
+                }
+            }
+        }
+    });
+    if (!found) {
+        std::cerr << "unknown lock: " << only_lock << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Lock primitives with BasicLockable interface (lock/unlock),
+// so all of them can be used with std::unique_lock and std::condition_variable_any.
+
+// not cpu_relax(), boost fiber defines a macro with that name
+inline void cpu_pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// test-and-test-and-set spinlock with exponential backoff
+struct ttas_spinlock
+{
+    static constexpr uint32_t max_backoff = 1024;
+
+    std::atomic<bool> locked{false};
+
+    void lock()
+    {
+        uint32_t backoff = 1;
+        while (true) {
+            // spin on read, don't bounce cache line with writes
+            while (locked.load(std::memory_order_relaxed)) {
+                cpu_pause();
+            }
+            if (!locked.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            for (uint32_t i = 0; i < backoff; i++) {
+                cpu_pause();
+            }
+            if (backoff < max_backoff) {
+                backoff *= 2;
+            }
+        }
+    }
+
+    bool try_lock()
+    {
+        return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+// FIFO ticket lock
+struct ticket_lock
+{
+    alignas(64) std::atomic<uint32_t> next_ticket{0};
+    alignas(64) std::atomic<uint32_t> now_serving{0};
+
+    void lock()
+    {
+        uint32_t my_ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        while (true) {
+            uint32_t serving = now_serving.load(std::memory_order_acquire);
+            if (serving == my_ticket) {
+                return;
+            }
+            // proportional backoff: wait longer when more threads are ahead
+            for (uint32_t i = 0; i < (my_ticket - serving) * 16; i++) {
+                cpu_pause();
+            }
+        }
+    }
+
+    void unlock()
+    {
+        now_serving.store(now_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// MCS queue lock: every waiter spins on its own node.
+// Node is thread_local, so one thread can't hold two mcs_locks at the same time.
+struct mcs_lock
+{
+    struct alignas(64) node_t
+    {
+        std::atomic<node_t*> next{nullptr};
+        std::atomic<bool> locked{false};
+    };
+
+    std::atomic<node_t*> tail{nullptr};
+
+    static node_t& my_node()
+    {
+        thread_local node_t node;
+        return node;
+    }
+
+    void lock()
+    {
+        node_t& me = my_node();
+        me.next.store(nullptr, std::memory_order_relaxed);
+        me.locked.store(true, std::memory_order_relaxed);
+
+        node_t* prev = tail.exchange(&me, std::memory_order_acq_rel);
+        if (prev == nullptr) {
+            return;
+        }
+        prev->next.store(&me, std::memory_order_release);
+        while (me.locked.load(std::memory_order_acquire)) {
+            cpu_pause();
+        }
+    }
+
+    void unlock()
+    {
+        node_t& me = my_node();
+        node_t* next = me.next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            node_t* expected = &me;
+            if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                return;
+            }
+            // successor is between tail.exchange() and prev->next.store()
+            while ((next = me.next.load(std::memory_order_acquire)) == nullptr) {
+                cpu_pause();
+            }
+        }
+        next->locked.store(false, std::memory_order_release);
+    }
+};
+
+// Raw futex mutex, "Futexes Are Tricky" by U. Drepper, mutex #2
+// 0 - unlocked, 1 - locked, 2 - locked with waiters
+struct futex_mutex
+{
+    std::atomic<uint32_t> state{0};
+
+    static long futex(std::atomic<uint32_t>* addr, int op, uint32_t val)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, nullptr, nullptr, 0);
+    }
+
+    void lock()
+    {
+        uint32_t c = 0;
+        if (state.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+            return;
+        }
+        if (c != 2) {
+            c = state.exchange(2, std::memory_order_acquire);
+        }
+        while (c != 0) {
+            futex(&state, FUTEX_WAIT_PRIVATE, 2);
+            c = state.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    void unlock()
+    {
+        if (state.fetch_sub(1, std::memory_order_release) != 1) {
+            state.store(0, std::memory_order_release);
+            futex(&state, FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+};
+
+template<typename L>
+constexpr const char* lock_name = "unknown";
+template<>
+constexpr const char* lock_name<std::mutex> = "std_mutex";
+template<>
+constexpr const char* lock_name<ttas_spinlock> = "ttas";
+template<>
+constexpr const char* lock_name<ticket_lock> = "ticket";
+template<>
+constexpr const char* lock_name<mcs_lock> = "mcs";
+template<>
+constexpr const char* lock_name<futex_mutex> = "futex";
+template<>
+constexpr const char* lock_name<std::shared_mutex> = "shared_mutex";
+
+template<typename L>
+struct lock_tag
+{
+    using type = L;
+};
+
+// calls f(lock_tag<L>{}) for every lock type
+template<typename F>
+void for_each_lock_type(F&& f)
+{
+    f(lock_tag<std::mutex>{});
+    f(lock_tag<ttas_spinlock>{});
+    f(lock_tag<ticket_lock>{});
+    f(lock_tag<mcs_lock>{});
+    f(lock_tag<futex_mutex>{});
+    f(lock_tag<std::shared_mutex>{});
+}
+
+// calls f(lock_tag<L>{}) for lock type with given name, returns false if name is unknown
+template<typename F>
+bool visit_lock_type(const std::string& name, F&& f)
+{
+    bool found = false;
+    for_each_lock_type([&](auto tag) {
+        if (!found && name == lock_name<typename decltype(tag)::type>) {
+            found = true;
+            f(tag);
+        }
+    });
+    return found;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+
+#include "options.h"
+
+// Decides which messages carry create timestamp and get their latency recorded.
+// Every n-th message or, in random mode, 1/n of messages on average
+// with uniformly distributed gaps in [1, 2n-1] between sampled messages.
+// Unsampled messages are sent as BARE_MSG frames: producer doesn't read the clock
+// for them, consumer only counts them for throughput.
+struct msg_sampler_t
+{
+    size_t every = 1;
+    bool random = false;
+
+    size_t countdown = 1;
+    std::minstd_rand rng{std::random_device{}()};
+
+    // [sample=N] [sample_random=1]
+    void configure(const options_t& opts)
+    {
+        every = std::max(1l, opts.get_int("sample", 1));
+        random = opts.get_int("sample_random", 0) != 0;
+        reset();
+    }
+
+    // next message will be sampled, called at batch start so every batch has samples
+    void reset()
+    {
+        countdown = 1;
+    }
+
+    bool next()
+    {
+        if (--countdown > 0) {
+            return false;
+        }
+        if (random) {
+            countdown = std::uniform_int_distribution<size_t>(1, 2 * every - 1)(rng);
+        } else {
+            countdown = every;
+        }
+        return true;
+    }
+};
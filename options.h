@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Command line: positional arguments followed by optional key=value pairs.
+// Keys which were read are remembered, so typos and options of other modes can be reported.
+struct options_t
+{
+    std::vector<std::string> positional;
+    std::map<std::string, std::string> named;
+    mutable std::set<std::string> used;
+
+    options_t(int argc, const char* argv[])
+    {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto eq = arg.find('=');
+            if (eq == std::string::npos) {
+                positional.push_back(arg);
+            } else {
+                named[arg.substr(0, eq)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    bool has(const std::string& key) const
+    {
+        used.insert(key);
+        return named.count(key) > 0;
+    }
+
+    std::string get(const std::string& key, const std::string& def) const
+    {
+        used.insert(key);
+        auto it = named.find(key);
+        return it == named.end() ? def : it->second;
+    }
+
+    long get_int(const std::string& key, long def) const
+    {
+        used.insert(key);
+        auto it = named.find(key);
+        return it == named.end() ? def : strtol(it->second.c_str(), 0, 0);
+    }
+
+    double get_double(const std::string& key, double def) const
+    {
+        used.insert(key);
+        auto it = named.find(key);
+        return it == named.end() ? def : strtod(it->second.c_str(), 0);
+    }
+
+    // comma separated list of integers, e.g. threads=1,2,4,8
+    std::vector<long> get_int_list(const std::string& key, const std::vector<long>& def) const
+    {
+        used.insert(key);
+        auto it = named.find(key);
+        if (it == named.end()) {
+            return def;
+        }
+        std::vector<long> values;
+        const std::string& list = it->second;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t comma = list.find(',', pos);
+            if (comma == std::string::npos) {
+                comma = list.size();
+            }
+            values.push_back(strtol(list.substr(pos, comma - pos).c_str(), 0, 0));
+            pos = comma + 1;
+        }
+        return values;
+    }
+
+    // keys given on command line and never read
+    std::vector<std::string> unused() const
+    {
+        std::vector<std::string> keys;
+        for (const auto& [key, _] : named) {
+            if (used.count(key) == 0) {
+                keys.push_back(key);
+            }
+        }
+        return keys;
+    }
+};
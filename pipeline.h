@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "deadline.h"
+#include "hiccup_meter.h"
+#include "msg_sampler.h"
+#include "options.h"
+#include "queue_monitor.h"
+#include "result_table.h"
+#include "select.h"
+
+// Backend independent part of the benchmark: frames, rate schedule and stage logic.
+//
+// Pipeline is producer -> (n_queues - 1) pipe stages -> consumer, connected with n_queues queues.
+// Backend provides queue type and the way stages are executed. Blocking backends (threads, fibers)
+// implement:
+//     using queue = ...;
+//     std::shared_ptr<queue> make_queue();
+//     static void send(queue&, const msg_t&);
+//     static msg_t recv(queue&);
+//     static void sleep_for(std::chrono::nanoseconds);
+//     struct pacer { void wait(std::chrono::nanoseconds); };  // delay between produced messages
+//     template<typename F> void spawn(F&&);  // first spawned stage is consumer, last is producer
+//     void run();  // returns when all stages exited
+// and are driven by run_blocking_pipeline(). All calls are resolved at compile time.
+
+using hr_clock = std::chrono::high_resolution_clock;
+
+enum FrameType
+{
+    MSG,
+    // message without timestamp, not sampled for latency
+    BARE_MSG,
+    BATCH_END,
+    FINISH
+};
+
+// Deadline and enqueue time are 32-bit offsets from create_timestamp (see deadline.h),
+// so deadline support doesn't grow frames on the measured path.
+struct msg_t
+{
+    hr_clock::time_point create_timestamp;
+    FrameType type;
+    // desired throughput, objs/s
+    uint32_t throughput;
+    // 0 - no deadline
+    uint32_t deadline_us = 0;
+    // set on send only in CoDel mode
+    uint32_t enqueue_offset_ns = 0;
+
+    bool sheddable() const
+    {
+        return type == FrameType::MSG;
+    }
+
+    hr_clock::time_point deadline() const
+    {
+        return deadline_us ? create_timestamp + std::chrono::microseconds(deadline_us) : hr_clock::time_point{};
+    }
+
+    hr_clock::time_point enqueue_timestamp() const
+    {
+        return create_timestamp + std::chrono::nanoseconds(enqueue_offset_ns);
+    }
+
+    void set_enqueue_timestamp(hr_clock::time_point now)
+    {
+        if (sheddable()) {
+            int64_t offset = std::chrono::nanoseconds(now - create_timestamp).count();
+            enqueue_offset_ns = std::clamp<int64_t>(offset, 0, UINT32_MAX);
+        }
+    }
+};
+
+static_assert(sizeof(msg_t) == 24, "frame must stay as small as without deadlines");
+
+inline queue_monitor_t monitor;
+inline hiccup_meter_t hiccups;
+inline msg_sampler_t sampler;
+inline result_table_t results;
+
+inline void pin_current_thread(int cpu)
+{
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Restores affinity of the calling thread on destruction, for backends which pin the main thread:
+// threads started after the run (parallel stats) must not inherit the pin.
+struct affinity_guard_t
+{
+    cpu_set_t saved;
+    bool valid;
+
+    affinity_guard_t()
+    {
+        CPU_ZERO(&saved);
+        valid = pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0;
+    }
+
+    ~affinity_guard_t()
+    {
+        if (valid) {
+            pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+        }
+    }
+};
+
+// Desired throughput levels, each level is a batch of messages followed by pause.
+struct rate_schedule_t
+{
+    std::vector<size_t> rates;
+    // max messages per level
+    size_t batch_size = 100'000;
+    std::chrono::milliseconds batch_time{1000};
+    // pause after level is pause + random [0, pause_jitter)
+    std::chrono::milliseconds pause{500};
+    std::chrono::milliseconds pause_jitter{1000};
+    // pause before FINISH
+    std::chrono::milliseconds finish_delay{200};
+    // pause after each level, drawn once so all producers of fan-in keep in step
+    std::vector<std::chrono::milliseconds> pauses;
+
+    // [rates=10,20,50,...] [batch_size=100000] [batch_time_ms=1000] [pause_ms=500] [pause_jitter_ms=1000]
+    void configure(const options_t& opts)
+    {
+        std::vector<long> defaults;
+        for (long d1 : {10, 100, 1000, 10'000, 100'000, 1000'000, 10'000'000, 100'000'000}) {
+            for (long d2 : {1, 2, 5}) {
+                defaults.push_back(d1 * d2);
+            }
+        }
+        rates.clear();
+        for (long r : opts.get_int_list("rates", defaults)) {
+            if (r > 0) {
+                rates.push_back(r);
+            }
+        }
+        batch_size = opts.get_int("batch_size", 100'000);
+        batch_time = std::chrono::milliseconds(opts.get_int("batch_time_ms", 1000));
+        pause = std::chrono::milliseconds(opts.get_int("pause_ms", 500));
+        pause_jitter = std::chrono::milliseconds(opts.get_int("pause_jitter_ms", 1000));
+        pauses.clear();
+        for (size_t i = 0; i < rates.size(); i++) {
+            pauses.push_back(pause + std::chrono::milliseconds(pause_jitter.count() > 0 ? rand() % pause_jitter.count() : 0));
+        }
+    }
+
+    std::chrono::milliseconds pause_after_level(size_t level) const
+    {
+        return pauses.at(level);
+    }
+};
+
+// One level of rate schedule: at most batch_size messages during at most batch_time.
+// Message count is clamped to what fits into batch_time at desired rate, so the level doesn't depend
+// on clock reads. Clock is read for sampled messages and, when delay makes it negligible, for every message,
+// the time limit only stops producer which can't keep up.
+// With n_producers > 1 messages of the level are dealt round robin: producer i sends messages i, i+n, ...
+// with n times the delay, starting at phase i * delay / n, so the total rate is kept and producers don't
+// send in lockstep; producer left without messages sends only BATCH_END. Frames carry the total rate.
+// Every producer sends BATCH_END at the nominal end of the level, so producers stay on the same level.
+struct producer_batch_t
+{
+    size_t throughput;
+    std::chrono::nanoseconds delay;
+    // delay before the first message
+    std::chrono::nanoseconds phase;
+    size_t count;
+    msg_sampler_t& sampler;
+    hr_clock::time_point started;
+    hr_clock::time_point stop_before;
+    // nominal end of the level
+    hr_clock::time_point end_at;
+    hr_clock::time_point now;
+
+    producer_batch_t(size_t desired_throughput, const rate_schedule_t& schedule, msg_sampler_t& msg_sampler = ::sampler,
+                     size_t producer_id = 0, size_t n_producers = 1)
+        : throughput(desired_throughput)
+        , delay(1000'000'000 * n_producers / desired_throughput)
+        , phase(1000'000'000 * producer_id / desired_throughput)
+        , count(share_of(level_count(desired_throughput, schedule), producer_id, n_producers))
+        , sampler(msg_sampler)
+    {
+        if (producer_id == 0) {
+            std::cerr << throughput << std::endl;
+            monitor.set_throughput(throughput);
+            hiccups.set_throughput(throughput);
+        }
+        sampler.reset();
+        started = now = hr_clock::now();
+        stop_before = started + schedule.batch_time;
+        std::chrono::duration<double> level_time(
+            (double)level_count(desired_throughput, schedule) / desired_throughput);
+        end_at = std::min(stop_before, started + std::chrono::duration_cast<hr_clock::duration>(level_time));
+    }
+
+    std::chrono::nanoseconds until_end() const
+    {
+        return std::max<std::chrono::nanoseconds>(std::chrono::nanoseconds(0), end_at - hr_clock::now());
+    }
+
+    // messages of all producers: batch_size, but not more than fits into batch_time at desired rate
+    static size_t level_count(size_t throughput, const rate_schedule_t& schedule)
+    {
+        std::chrono::duration<double> batch_time = schedule.batch_time;
+        return std::clamp<size_t>(batch_time.count() * throughput, 1, std::max<size_t>(1, schedule.batch_size));
+    }
+
+    static size_t share_of(size_t total, size_t producer_id, size_t n_producers)
+    {
+        return total / n_producers + (producer_id < total % n_producers ? 1 : 0);
+    }
+
+    // delay from which clock is read for every message
+    static constexpr std::chrono::nanoseconds clock_read_delay{1000};
+
+    bool next(msg_t& msg)
+    {
+        if (count == 0) {
+            return false;
+        }
+        bool sampled = sampler.next();
+        if (sampled || delay >= clock_read_delay) {
+            now = hr_clock::now();
+        }
+        if (now >= stop_before) {
+            return false;
+        }
+        count--;
+        if (sampled) {
+            msg = {now, FrameType::MSG, (uint32_t)throughput, deadline_policy.budget_us()};
+        } else {
+            msg = {{}, FrameType::BARE_MSG, (uint32_t)throughput};
+        }
+        return true;
+    }
+
+    msg_t end() const
+    {
+        return {started, FrameType::BATCH_END, (uint32_t)throughput};
+    }
+};
+
+inline msg_t finish_msg()
+{
+    return {hr_clock::now(), FrameType::FINISH, 0};
+}
+
+// Records latencies, throughput and goodput of received messages.
+// With n_inputs producers level ends on the last BATCH_END and the run on the last FINISH.
+struct consumer_stage_t
+{
+    size_t n_inputs = 1;
+    size_t received = 0;
+    size_t batch_ends = 0;
+    size_t finished = 0;
+    hr_clock::time_point started = hr_clock::time_point::max();
+    deadline_counter_t on_time;
+
+    // returns true on last FINISH
+    bool on_msg(const msg_t& msg)
+    {
+        received++;
+        if (msg.type == FrameType::BARE_MSG) {
+            return false;
+        }
+        auto stop = hr_clock::now();
+        if (msg.type == FrameType::MSG) {
+            std::chrono::duration<double, std::nano> latency = stop - msg.create_timestamp;
+            results.get_lats(msg.throughput).push_back(latency.count());
+            on_time.on_msg(msg.deadline(), stop);
+        }
+        if (msg.type == FrameType::BATCH_END) {
+            // batch of every producer starts when it sends its first message
+            started = std::min(started, msg.create_timestamp);
+            if (++batch_ends < n_inputs) {
+                return false;
+            }
+            std::chrono::duration<double, std::nano> elapsed = stop - started;
+            // control frames are not messages
+            double delivered = received - n_inputs;
+            uint64_t dropped = on_time.take_dropped();
+            // raw throughput includes frames shed on the way, goodput only on-time deliveries
+            double actual_throughput = (delivered + dropped) * 1000000000 / elapsed.count();
+            double delivered_throughput = delivered * 1000000000 / elapsed.count();
+            results.throughput.emplace(msg.throughput, actual_throughput);
+            results.goodput.emplace(msg.throughput, on_time.goodput(delivered_throughput));
+            results.dropped.emplace(msg.throughput, dropped);
+            received = 0;
+            batch_ends = 0;
+            started = hr_clock::time_point::max();
+        }
+        return msg.type == FrameType::FINISH && ++finished == n_inputs;
+    }
+};
+
+// Backend independent benchmark settings
+struct bench_config_t
+{
+    int n_queues = 1;
+    // fiber channels and shard mailboxes
+    size_t queue_capacity = 1024;
+    // CPUs for stage threads, fiber scheduler threads or shards, empty - no pinning
+    std::vector<int> affinity;
+    rate_schedule_t schedule;
+
+    std::string monitor_filename;
+    std::chrono::microseconds monitor_interval{10'000};
+
+    // pipeline or fan_in
+    std::string topology = "pipeline";
+    bool fan_in = false;
+    size_t n_inputs = 2;
+    select_order_t select_order = select_order_t::FAIR;
+
+    // [queues=1] [queue_capacity=1024] [affinity=0,1,2] [monitor=queues.csv] [monitor_interval_us=10000]
+    // [topology=pipeline|fan_in] fan_in: [inputs=2] [select=fair|priority]
+    void configure(const options_t& opts)
+    {
+        n_queues = opts.get_int("queues", 1);
+        queue_capacity = std::max(0l, opts.get_int("queue_capacity", 1024));
+        for (long cpu : opts.get_int_list("affinity", {})) {
+            affinity.push_back(cpu);
+        }
+        schedule.configure(opts);
+        monitor_filename = opts.get("monitor", "");
+        monitor_interval = std::chrono::microseconds(opts.get_int("monitor_interval_us", 10'000));
+        topology = opts.get("topology", "pipeline");
+        fan_in = topology == "fan_in";
+        // not read for pipeline, so they are reported as unused
+        if (fan_in) {
+            n_inputs = std::max(1l, opts.get_int("inputs", 2));
+            select_order = parse_select_order(opts.get("select", "fair"));
+        }
+    }
+
+    // returns false with message on settings no backend can run
+    bool check() const
+    {
+        if (topology != "pipeline" && !fan_in) {
+            std::cerr << "unknown topology: " << topology << std::endl;
+            return false;
+        }
+        if (n_queues < 1) {
+            std::cerr << "queues must be positive: " << n_queues << std::endl;
+            return false;
+        }
+        // empty channel would park both sides forever
+        if (queue_capacity < 1) {
+            std::cerr << "queue_capacity must be positive" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // i-th thread -> CPU, -1 - not pinned
+    int cpu_for(size_t i) const
+    {
+        return affinity.empty() ? -1 : affinity[i % affinity.size()];
+    }
+};
+
+// stages must be in order from producer to consumer, or parallel inputs of the consumer
+inline void start_instruments(const bench_config_t& cfg, const std::vector<const queue_counters_t*>& stages,
+                              bool parallel = false)
+{
+    if (!cfg.monitor_filename.empty()) {
+        for (auto* counters : stages) {
+            monitor.add_stage(counters);
+        }
+        monitor.parallel = parallel;
+        monitor.start(cfg.monitor_filename, cfg.monitor_interval);
+    }
+    if (hiccups.requested()) {
+        hiccups.start();
+    }
+}
+
+inline void stop_instruments()
+{
+    monitor.stop();
+    hiccups.stop();
+}
+
+template<typename Backend>
+void producer_worker(typename Backend::queue& sink, const rate_schedule_t& schedule, size_t producer_id = 0,
+                     size_t n_producers = 1)
+{
+    typename Backend::pacer pacer;
+    // samplers are not shared between producers
+    msg_sampler_t my_sampler = sampler;
+    my_sampler.rng.seed(std::random_device{}());
+    for (size_t level = 0; level < schedule.rates.size(); level++) {
+        producer_batch_t batch(schedule.rates[level], schedule, my_sampler, producer_id, n_producers);
+        msg_t msg;
+        if (batch.count > 0 && batch.phase.count() > 0) {
+            pacer.wait(batch.phase);
+        }
+        while (batch.next(msg)) {
+            Backend::send(sink, msg);
+            // no wait after the last message, with many producers delay is long
+            if (batch.count > 0) {
+                pacer.wait(batch.delay);
+            }
+        }
+        pacer.wait(batch.until_end());
+        Backend::send(sink, batch.end());
+        Backend::sleep_for(schedule.pause_after_level(level));
+    }
+    Backend::sleep_for(schedule.finish_delay);
+    Backend::send(sink, finish_msg());
+    if (producer_id == 0) {
+        std::cerr << "prod exit" << std::endl;
+    }
+}
+
+template<typename Backend>
+void consumer_worker(typename Backend::queue& src)
+{
+    consumer_stage_t consumer;
+    while (!consumer.on_msg(Backend::recv(src))) { }
+    std::cerr << "cons exit" << std::endl;
+}
+
+// single consumer waiting on all inputs of selector
+template<typename Backend>
+void fan_in_consumer_worker(typename Backend::selector& inputs)
+{
+    consumer_stage_t consumer;
+    consumer.n_inputs = inputs.queues.size();
+    msg_t msg;
+    while (true) {
+        inputs.recv(msg);
+        if (consumer.on_msg(msg)) {
+            break;
+        }
+    }
+    std::cerr << "cons exit" << std::endl;
+}
+
+template<typename Backend>
+void pipe_worker(typename Backend::queue& src, typename Backend::queue& sink)
+{
+    while (true) {
+        auto x = Backend::recv(src);
+        Backend::send(sink, x);
+        if (x.type == FrameType::FINISH) {
+            break;
+        }
+    }
+    std::cerr << "pipe exit" << std::endl;
+}
+
+template<typename Backend>
+void run_blocking_pipeline(Backend& backend, const bench_config_t& cfg)
+{
+    using queue = typename Backend::queue;
+
+    auto q1 = backend.make_queue();
+    backend.spawn([q1]() { consumer_worker<Backend>(*q1); });
+
+    std::shared_ptr<queue> sink = q1;
+    std::vector<const queue_counters_t*> stages{&q1->counters};
+
+    for (int i = 0; i < cfg.n_queues - 1; i++) {
+        auto src = backend.make_queue();
+        backend.spawn([src, sink]() { pipe_worker<Backend>(*src, *sink); });
+        sink = src;
+        stages.push_back(&src->counters);
+    }
+    std::reverse(stages.begin(), stages.end());
+
+    start_instruments(cfg, stages);
+
+    backend.spawn([sink, &cfg]() { producer_worker<Backend>(*sink, cfg.schedule); });
+    backend.run();
+
+    stop_instruments();
+}
+
+// Fan-in: n_inputs producers, each sends its share of rate to own queue, one consumer selects over all of them.
+// Backend additionally provides:
+//     using selector = selector_t<queue, ...>;  // see select.h
+template<typename Backend>
+void run_blocking_fan_in(Backend& backend, const bench_config_t& cfg)
+{
+    using queue = typename Backend::queue;
+
+    std::vector<std::shared_ptr<queue>> inputs;
+    auto selector = std::make_shared<typename Backend::selector>(cfg.select_order);
+    std::vector<const queue_counters_t*> stages;
+    for (size_t i = 0; i < cfg.n_inputs; i++) {
+        inputs.push_back(backend.make_queue());
+        selector->add(*inputs.back());
+        stages.push_back(&inputs.back()->counters);
+    }
+    backend.spawn([selector]() { fan_in_consumer_worker<Backend>(*selector); });
+
+    start_instruments(cfg, stages, true);
+
+    for (size_t i = 0; i < cfg.n_inputs; i++) {
+        backend.spawn([sink = inputs[i], &cfg, i]() { producer_worker<Backend>(*sink, cfg.schedule, i, cfg.n_inputs); });
+    }
+    backend.run();
+
+    stop_instruments();
+}
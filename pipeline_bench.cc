@@ -0,0 +1,161 @@
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "coro_backend.h"
+#include "deadline.h"
+#include "fiber_backend.h"
+#include "hiccup_meter.h"
+#include "locks.h"
+#include "msg_sampler.h"
+#include "options.h"
+#include "pipeline.h"
+#include "result_table.h"
+#include "shard_backend.h"
+#include "thread_backend.h"
+
+// Single driver for all backends, every backend runs the same rate schedule with the same stage logic.
+// Backend and queue type are selected at startup, hot paths are instantiated per backend at compile time.
+// Options which the selected backend and topology don't read are rejected before the run.
+
+template<typename Backend>
+void run_topology(Backend& backend, const bench_config_t& cfg)
+{
+    if (cfg.fan_in) {
+        run_blocking_fan_in(backend, cfg);
+    } else {
+        run_blocking_pipeline(backend, cfg);
+    }
+}
+
+// Called after backend read its options and before the run: every option must have been read by now,
+// otherwise it's a typo or belongs to another backend or topology.
+bool check_options(const options_t& opts)
+{
+    bool ok = true;
+    for (const auto& key : opts.unused()) {
+        std::cerr << "unknown option or not used by this backend/topology: " << key << std::endl;
+        ok = false;
+    }
+    for (const auto& arg : opts.positional) {
+        std::cerr << "unexpected argument, options are key=value: " << arg << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// returns false if backend, queue or any option is not valid
+bool run_benchmark(const std::string& backend, const bench_config_t& cfg, const options_t& opts)
+{
+    if (cfg.fan_in && backend != "threads" && backend != "fibers") {
+        std::cerr << "fan_in is supported only by threads and fibers backends" << std::endl;
+        return false;
+    }
+
+    if (backend == "threads") {
+        std::string lock = opts.get("queue", lock_name<std::mutex>);
+        bool ok = false;
+        bool found = visit_lock_type(lock, [&](auto tag) {
+            thread_backend<typename decltype(tag)::type> b(cfg);
+            ok = check_options(opts);
+            if (ok) {
+                run_topology(b, cfg);
+            }
+        });
+        if (!found) {
+            std::cerr << "unknown queue lock: " << lock << std::endl;
+        }
+        return found && ok;
+    }
+    if (backend == "fibers") {
+        fiber_backend b(cfg, opts);
+        if (!check_options(opts)) {
+            return false;
+        }
+        run_topology(b, cfg);
+        return true;
+    }
+    if (backend == "coro") {
+        coro_backend b(cfg);
+        if (!check_options(opts)) {
+            return false;
+        }
+        b.run_pipeline();
+        return true;
+    }
+    if (backend == "shards") {
+        shard_backend b(cfg, opts);
+        if (!check_options(opts)) {
+            return false;
+        }
+        b.run_pipeline();
+        return true;
+    }
+    std::cerr << "unknown backend: " << backend << std::endl;
+    return false;
+}
+
+int main(int argc, const char* argv[])
+{
+    srand(((uint64_t)(&argc)) % 1000'000'000);
+
+    // pipeline_bench [backend=threads|fibers|coro|shards] [queues=1] [queue_capacity=1024] [affinity=0,1,2]
+    //     [topology=pipeline|fan_in] fan_in: [inputs=2] [select=fair|priority]
+    //     [rates=10,20,50,...] [batch_size=100000] [batch_time_ms=1000] [pause_ms=500] [pause_jitter_ms=1000]
+    // threads: [queue=std_mutex|ttas|ticket|mcs|futex|shared_mutex]
+    // fibers:  [fiber_threads=N] [scheduler=work_stealing|shared_work]
+    // shards:  [shards=N] [mapping=block|round_robin] [poll_batch=64]
+    // output:  [latency=latency.csv] [throughput=throughput.csv] [stats=stats.csv]
+    //     [mean=mean.csv] [median=median.csv] [mean_per_throughput=f.csv] [median_per_throughput=f.csv]
+    //     [sample=N] [sample_random=1] [monitor=queues.csv] [monitor_interval_us=10000]
+    //     [deadline_us=N] [shed=drop|codel] [codel_target_us=5000] [codel_interval_us=100000]
+    //     [hiccups=hiccups.csv] [platform=cpufreq.csv] [hiccup_mode=sleep|spin] [hiccup_interval_us=1000] [hiccup_cpu=N]
+    options_t opts(argc, argv);
+    hiccups.configure(opts);
+    sampler.configure(opts);
+    deadline_policy.configure(opts);
+    bench_config_t cfg;
+    cfg.configure(opts);
+    if (!cfg.check()) {
+        return 1;
+    }
+    // read before the run, so they are not reported as unused
+    std::map<std::string, std::string> outputs;
+    for (const char* key :
+         {"latency", "throughput", "stats", "mean", "median", "mean_per_throughput", "median_per_throughput"}) {
+        outputs[key] = opts.get(key, "");
+    }
+
+    if (!run_benchmark(opts.get("backend", "threads"), cfg, opts)) {
+        return 1;
+    }
+
+    results.calc_stats();
+    if (!outputs["latency"].empty()) {
+        results.dump_latencies(outputs["latency"]);
+    }
+    if (!outputs["throughput"].empty()) {
+        results.dump_throughput(outputs["throughput"]);
+    }
+    if (!outputs["stats"].empty()) {
+        results.dump_stats(outputs["stats"]);
+    }
+    if (!outputs["mean"].empty()) {
+        dump_dict(outputs["mean"], results.mean_latencies);
+    }
+    if (!outputs["median"].empty()) {
+        dump_dict(outputs["median"], results.median_latencies);
+    }
+    if (!outputs["mean_per_throughput"].empty()) {
+        dump_dict(outputs["mean_per_throughput"], results.mean_per_throughput);
+    }
+    if (!outputs["median_per_throughput"].empty()) {
+        dump_dict(outputs["median_per_throughput"], results.median_per_throughput);
+    }
+    hiccups.dump();
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Enqueue/dequeue counters of a single queue.
+// Updated by queue users with relaxed atomics, read by monitor thread.
+struct queue_counters_t
+{
+    alignas(64) std::atomic<uint64_t> enqueued{0};
+    alignas(64) std::atomic<uint64_t> dequeued{0};
+
+    void on_enqueue()
+    {
+        enqueued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void on_dequeue()
+    {
+        dequeued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t depth() const
+    {
+        return enqueued.load(std::memory_order_relaxed) - dequeued.load(std::memory_order_relaxed);
+    }
+};
+
+// Thread that periodically samples counters of all pipeline queues
+// and streams time series into file, one line per queue per sample:
+//   time_ms desired_throughput stage depth enq_rate deq_rate lag
+// stage 0 is the queue right after producer, last stage is the consumer's queue,
+// lag is the number of items which entered the stage and are not yet received by consumer.
+// Parallel stages (fan-in inputs of one consumer) are not a chain, their lag is their own depth.
+// Samples are separated with empty line (gnuplot data blocks).
+struct queue_monitor_t
+{
+    std::vector<const queue_counters_t*> stages;
+    bool parallel = false;
+    std::atomic<double> desired_throughput{0};
+
+    std::chrono::microseconds interval{10'000};
+    std::ofstream of;
+    std::atomic<bool> stopped{false};
+    std::thread sampler;
+
+    // stages must be in order from producer to consumer
+    void add_stage(const queue_counters_t* counters)
+    {
+        stages.push_back(counters);
+    }
+
+    void set_throughput(double throughput)
+    {
+        desired_throughput.store(throughput, std::memory_order_relaxed);
+    }
+
+    bool enabled() const
+    {
+        return sampler.joinable();
+    }
+
+    void start(const std::string& filename, std::chrono::microseconds sample_interval)
+    {
+        interval = sample_interval;
+        of.open(filename);
+        std::cerr << "monitor queues to " << filename << " every " << interval.count() << "us" << std::endl;
+        stopped = false;
+        sampler = std::thread([this]() { run(); });
+    }
+
+    void stop()
+    {
+        if (!sampler.joinable()) {
+            return;
+        }
+        stopped = true;
+        sampler.join();
+        of.close();
+        stages.clear();
+        parallel = false;
+    }
+
+    void run()
+    {
+        using clock = std::chrono::steady_clock;
+
+        std::vector<uint64_t> prev_enq(stages.size(), 0);
+        std::vector<uint64_t> prev_deq(stages.size(), 0);
+        std::vector<uint64_t> enq(stages.size());
+        std::vector<uint64_t> deq(stages.size());
+
+        auto started = clock::now();
+        auto prev = started;
+        auto next = started + interval;
+        while (!stopped.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_until(next);
+            next += interval;
+
+            auto now = clock::now();
+            // read consumer's side first, so lag never goes negative
+            for (size_t i = stages.size(); i-- > 0;) {
+                deq[i] = stages[i]->dequeued.load(std::memory_order_relaxed);
+                enq[i] = stages[i]->enqueued.load(std::memory_order_relaxed);
+            }
+            std::chrono::duration<double> dt = now - prev;
+            std::chrono::duration<double, std::milli> t = now - started;
+            double throughput = desired_throughput.load(std::memory_order_relaxed);
+            uint64_t consumed = deq.empty() ? 0 : deq.back();
+
+            for (size_t i = 0; i < stages.size(); i++) {
+                of << t.count() << " " << throughput << " " << i << " " << (int64_t)(enq[i] - deq[i]) << " "
+                   << (enq[i] - prev_enq[i]) / dt.count() << " " << (deq[i] - prev_deq[i]) / dt.count() << " "
+                   << (int64_t)(enq[i] - (parallel ? deq[i] : consumed)) << "\n";
+            }
+            of << "\n";
+
+            prev = now;
+            prev_enq.swap(enq);
+            prev_deq.swap(deq);
+        }
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "stats.h"
+
+template<typename C>
+void dump_dict(const std::string& filename, const C& data)
+{
+    std::ofstream of;
+    of.open(filename);
+    std::cerr << "dump to " << filename << std::endl;
+    for (const auto& [k, v] : data) {
+        of << k << " " << v << std::endl;
+    }
+    of.close();
+}
+
+
+struct result_table_t
+{
+    std::unordered_map<size_t, std::deque<double>> latencies_per_desired_throughput;
+
+    std::deque<double>& get_lats(double throughput)
+    {
+        auto it = latencies_per_desired_throughput.find(throughput);
+        if (it == latencies_per_desired_throughput.end()) {
+            return latencies_per_desired_throughput[throughput] = {};
+        }
+        return it->second;
+    }
+
+    // desired throughput -> resulting average throughput obj/s
+    std::unordered_map<size_t, double> throughput;
+
+    // desired throughput -> messages delivered before deadline per second
+    std::unordered_map<size_t, double> goodput;
+
+    // desired throughput -> frames shed by queues
+    std::unordered_map<size_t, uint64_t> dropped;
+
+    void clear()
+    {
+        latencies_per_desired_throughput.clear();
+        throughput.clear();
+        goodput.clear();
+        dropped.clear();
+        stats.clear();
+        mean_latencies.clear();
+        median_latencies.clear();
+        mean_per_throughput.clear();
+        median_per_throughput.clear();
+    }
+
+    std::map<size_t, latency_stats_t> stats;
+
+    std::map<size_t, double> mean_latencies;
+    std::map<size_t, double> median_latencies;
+
+    std::map<double, double> mean_per_throughput;
+    std::map<double, double> median_per_throughput;
+
+    // reorders latencies of every bucket
+    void calc_stats()
+    {
+        std::map<size_t, std::deque<double>*> buckets;
+        for (auto& [throughput, lats] : latencies_per_desired_throughput) {
+            buckets[throughput] = &lats;
+        }
+        stats = calc_latency_stats_parallel(buckets);
+
+        for (const auto& [throughput, s] : stats) {
+            mean_latencies[throughput] = s.mean;
+            median_latencies[throughput] = s.p50;
+        }
+
+        for (const auto& [d, t] : throughput) {
+            // with sampling short batches can have no latency samples
+            if (mean_latencies.count(d) == 0) {
+                continue;
+            }
+            mean_per_throughput[t] = mean_latencies.at(d);
+            median_per_throughput[t] = median_latencies.at(d);
+        }
+    }
+
+    void dump_latencies(const std::string& latency_filename) const
+    {
+        std::ofstream lat_of;
+        lat_of.open(latency_filename);
+        std::cerr << "save latencies to " << latency_filename << std::endl;
+        for (const auto& [throughput, lats] : latencies_per_desired_throughput) {
+            for (auto latency : lats) {
+                lat_of << throughput << " " << latency << std::endl;
+            }
+        }
+        lat_of.close();
+    }
+
+    void dump_throughput(const std::string& throughput_filename) const
+    {
+        dump_dict(throughput_filename, std::map<size_t, double>(throughput.begin(), throughput.end()));
+    }
+
+    // desired_throughput actual_throughput count mean stddev min p50 p90 p99 p999 max goodput dropped
+    // actual throughput counts delivered and dropped frames, goodput only on-time deliveries,
+    // without deadlines goodput equals actual throughput
+    void dump_stats(const std::string& stats_filename) const
+    {
+        std::ofstream of;
+        of.open(stats_filename);
+        std::cerr << "save stats to " << stats_filename << std::endl;
+        for (const auto& [d, s] : stats) {
+            auto it = throughput.find(d);
+            double actual = it == throughput.end() ? 0 : it->second;
+            auto g = goodput.find(d);
+            auto dr = dropped.find(d);
+            of << d << " " << actual << " " << s.count << " " << s.mean << " " << s.stddev << " " << s.min << " "
+               << s.p50 << " " << s.p90 << " " << s.p99 << " " << s.p999 << " " << s.max << " "
+               << (g == goodput.end() ? actual : g->second) << " " << (dr == dropped.end() ? 0 : dr->second)
+               << std::endl;
+        }
+        of.close();
+    }
+
+    void dump(
+        const std::string& latency_filename,
+        const std::string& latency_mean_filename,
+        const std::string& latency_median_filename,
+        const std::string& latency_mean_per_throughput_filename,
+        const std::string& latency_median_per_throughput_filename
+    ) const
+    {
+        dump_latencies(latency_filename);
+
+        dump_dict(latency_mean_filename, mean_latencies);
+        dump_dict(latency_median_filename, median_latencies);
+        dump_dict(latency_mean_per_throughput_filename, mean_per_throughput);
+        dump_dict(latency_median_per_throughput_filename, median_per_throughput);
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Waiting on several queues at once without polling.
+// All queues of a selector share one wakeup object: sender notifies it after every push,
+// the only receiver scans queues with non-blocking try_recv() and sleeps on the wakeup when all are empty.
+// Mutex and CondVar are std:: types for threads and boost::fibers:: types for fibers.
+template<typename Mutex, typename CondVar>
+struct wakeup_t
+{
+    // incremented on every notify, receiver sleeps until it changes
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<uint32_t> waiting{0};
+    Mutex m;
+    CondVar cv;
+
+    void notify()
+    {
+        epoch.fetch_add(1);
+        // senders don't touch mutex while receiver is busy
+        if (waiting.load() > 0) {
+            std::unique_lock<Mutex> lock(m);
+            cv.notify_one();
+        }
+    }
+
+    uint64_t current() const
+    {
+        return epoch.load();
+    }
+
+    void wait(uint64_t seen)
+    {
+        std::unique_lock<Mutex> lock(m);
+        waiting.fetch_add(1);
+        cv.wait(lock, [this, seen]() { return epoch.load() != seen; });
+        waiting.fetch_sub(1);
+    }
+};
+
+enum class select_order_t
+{
+    // round robin, starting after the last served queue
+    FAIR,
+    // lower index first
+    PRIORITY
+};
+
+inline select_order_t parse_select_order(const std::string& name)
+{
+    return name == "priority" ? select_order_t::PRIORITY : select_order_t::FAIR;
+}
+
+// Queue must have `Wakeup* wakeup` member and `bool try_recv(T&)` method.
+template<typename Queue, typename Wakeup>
+struct selector_t
+{
+    std::vector<Queue*> queues;
+    Wakeup wakeup;
+    select_order_t order;
+    size_t next = 0;
+
+    selector_t(select_order_t select_order = select_order_t::FAIR)
+        : order(select_order)
+    { }
+
+    // must be called before any sender starts
+    void add(Queue& q)
+    {
+        q.wakeup = &wakeup;
+        queues.push_back(&q);
+    }
+
+    // returns index of queue the message was received from
+    template<typename T>
+    size_t recv(T& msg)
+    {
+        size_t n = queues.size();
+        while (true) {
+            // read before scan, so push after scan is not missed
+            uint64_t seen = wakeup.current();
+            size_t start = order == select_order_t::FAIR ? next : 0;
+            for (size_t i = 0; i < n; i++) {
+                size_t idx = start + i < n ? start + i : start + i - n;
+                if (queues[idx]->try_recv(msg)) {
+                    next = idx + 1 < n ? idx + 1 : 0;
+                    return idx;
+                }
+            }
+            wakeup.wait(seen);
+        }
+    }
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "hiccup_meter.h"
+#include "options.h"
+#include "pipeline.h"
+#include "shard_runtime.h"
+
+// Stages are handlers of shard-per-core runtime, see shard_runtime.h.
+// Deadline shedding is not supported, shards never block on queues.
+struct shard_backend
+{
+    // Producer can't block the shard, so it's a state machine polled by the shard loop.
+    // Messages which are due are sent in bursts of at most max_burst.
+    struct producer_t
+    {
+        enum state_t
+        {
+            PAUSE,
+            SENDING,
+            DONE
+        };
+
+        uint32_t sink;
+        size_t max_burst;
+        const rate_schedule_t& schedule;
+        size_t level = 0;
+
+        state_t state = PAUSE;
+        std::optional<producer_batch_t> batch;
+        hr_clock::time_point resume_at{};
+        hr_clock::time_point next_send;
+
+        template<typename Runtime>
+        bool operator()(Runtime& rt)
+        {
+            if (state == DONE) {
+                return false;
+            }
+            auto now = hr_clock::now();
+            if (state == PAUSE) {
+                if (now < resume_at) {
+                    return false;
+                }
+                if (level < schedule.rates.size()) {
+                    batch.emplace(schedule.rates[level++], schedule);
+                    next_send = batch->started;
+                    state = SENDING;
+                } else {
+                    rt.send(sink, finish_msg());
+                    state = DONE;
+                    std::cerr << "prod exit" << std::endl;
+                }
+                return true;
+            }
+
+            size_t sent = 0;
+            bool more = true;
+            msg_t msg;
+            while (now >= next_send && sent < max_burst && (more = batch->next(msg))) {
+                rt.send(sink, msg);
+                next_send += batch->delay;
+                sent++;
+            }
+            if (!more) {
+                rt.send(sink, batch->end());
+                state = PAUSE;
+                if (level < schedule.rates.size()) {
+                    resume_at = now + schedule.pause_after_level(level - 1);
+                } else {
+                    resume_at = now + schedule.finish_delay;
+                }
+            }
+            return sent > 0;
+        }
+    };
+
+    // pipe forwards to next stage, consumer records results and stops the runtime
+    struct stage_handler_t
+    {
+        static constexpr uint32_t CONSUMER = UINT32_MAX;
+
+        uint32_t next = CONSUMER;
+        consumer_stage_t consumer;
+
+        template<typename Runtime>
+        void operator()(Runtime& rt, msg_t& msg)
+        {
+            if (next != CONSUMER) {
+                rt.send(next, msg);
+            } else if (consumer.on_msg(msg)) {
+                std::cerr << "cons exit" << std::endl;
+                rt.stop();
+            }
+        }
+    };
+
+    using runtime_t = shard_runtime_t<msg_t, stage_handler_t, producer_t>;
+
+    const bench_config_t& cfg;
+    size_t n_shards;
+    bool round_robin;
+    size_t poll_batch;
+
+    // [shards=N] [mapping=block|round_robin] [poll_batch=64]
+    shard_backend(const bench_config_t& config, const options_t& opts)
+        : cfg(config)
+        , n_shards(std::max<long>(
+              1, opts.get_int("shards", std::min<long>(std::thread::hardware_concurrency(), config.n_queues + 1))))
+        , round_robin(opts.get("mapping", "block") == "round_robin")
+        , poll_batch(opts.get_int("poll_batch", 64))
+    {
+        std::cerr << "backend: shards, shards: " << n_shards << ", mapping: " << (round_robin ? "round_robin" : "block")
+                  << std::endl;
+    }
+
+    // pipeline position -> shard, position 0 is producer, n_positions-1 is consumer
+    size_t shard_of(size_t pos, size_t n_positions) const
+    {
+        if (round_robin) {
+            return pos % n_shards;
+        }
+        // contiguous blocks of stages, cross-shard hops only between blocks
+        return pos * n_shards / n_positions;
+    }
+
+    void run_pipeline()
+    {
+        auto all_cpus = hiccup_meter_t::affinity_cpus();
+        std::vector<int> cpus;
+        for (size_t i = 0; i < n_shards; i++) {
+            if (!cfg.affinity.empty()) {
+                cpus.push_back(cfg.cpu_for(i));
+            } else {
+                cpus.push_back(all_cpus.empty() ? -1 : all_cpus[i % all_cpus.size()]);
+            }
+        }
+
+        runtime_t rt(cpus, cfg.queue_capacity, poll_batch);
+
+        size_t n_positions = cfg.n_queues + 1;
+        size_t pos = n_positions - 1;
+
+        uint32_t sink = rt.add_stage(shard_of(pos, n_positions), stage_handler_t{});
+        std::vector<const queue_counters_t*> stages{&rt.stages[sink].counters};
+        for (int i = 0; i < cfg.n_queues - 1; i++) {
+            pos--;
+            sink = rt.add_stage(shard_of(pos, n_positions), stage_handler_t{sink});
+            stages.push_back(&rt.stages[sink].counters);
+        }
+        std::reverse(stages.begin(), stages.end());
+        rt.add_poller(shard_of(0, n_positions), producer_t{sink, poll_batch, cfg.schedule});
+
+        start_instruments(cfg, stages);
+
+        {
+            // shard 0 runs in this thread
+            affinity_guard_t guard;
+            rt.run();
+        }
+
+        stop_instruments();
+    }
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "locks.h"
+#include "queue_monitor.h"
+
+// Bounded single-producer single-consumer ring.
+// Both sides work in batches: writes become visible to consumer only after flush(),
+// consumer releases slots to producer once per pop_batch().
+template<typename T>
+struct spsc_ring
+{
+    std::vector<T> slots;
+    size_t mask;
+
+    // producer side
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t local_tail = 0;
+    size_t cached_head = 0;
+
+    // consumer side
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cached_tail = 0;
+
+    spsc_ring(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool try_push(const T& x)
+    {
+        if (local_tail - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (local_tail - cached_head > mask) {
+                return false;
+            }
+        }
+        slots[local_tail & mask] = x;
+        local_tail++;
+        return true;
+    }
+
+    void flush()
+    {
+        if (tail.load(std::memory_order_relaxed) != local_tail) {
+            tail.store(local_tail, std::memory_order_release);
+        }
+    }
+
+    // calls f(x) for at most max_batch items, returns number of items
+    template<typename F>
+    size_t pop_batch(size_t max_batch, F&& f)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail == h) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (cached_tail == h) {
+                return 0;
+            }
+        }
+        size_t n = std::min(max_batch, cached_tail - h);
+        for (size_t i = 0; i < n; i++) {
+            f(slots[(h + i) & mask]);
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+};
+
+// Shard-per-core runtime: one pinned thread per shard, shards share nothing but SPSC mailboxes.
+// Pipeline stages are handlers bound to shards. Message to a stage on the same shard goes
+// to the shard's local run queue, message to another shard goes through the mailbox
+// of that (source, destination) pair. Every shard loop iteration polls sources,
+// drains inbound mailboxes in batches, runs local queue and flushes outbound mailboxes.
+// Handler and Poller are concrete types, so delivery and polling are direct calls:
+//     void Handler::operator()(shard_runtime_t&, T&);
+//     bool Poller::operator()(shard_runtime_t&);  // returns true if did some work
+// Different stage kinds are told apart by Handler's own data.
+template<typename T, typename Handler, typename Poller>
+struct shard_runtime_t
+{
+    struct envelope_t
+    {
+        uint32_t stage;
+        T msg;
+    };
+
+    struct mailbox_t
+    {
+        spsc_ring<envelope_t> ring;
+        // messages which didn't fit into ring, sent before any new ones
+        std::deque<envelope_t> overflow;
+
+        mailbox_t(size_t capacity)
+            : ring(capacity)
+        { }
+    };
+
+    struct shard_t
+    {
+        int cpu = -1;
+        std::deque<envelope_t> run_queue;
+        std::vector<Poller> pollers;
+        // indexed by peer shard id, nullptr for itself
+        std::vector<mailbox_t*> inbound;
+        std::vector<mailbox_t*> outbound;
+    };
+
+    struct stage_t
+    {
+        size_t shard;
+        Handler handler;
+        queue_counters_t counters;
+    };
+
+    size_t batch_size;
+    std::vector<shard_t> shards;
+    std::vector<std::unique_ptr<mailbox_t>> mailboxes;
+    std::deque<stage_t> stages;
+    std::atomic<bool> stopped{false};
+
+    static thread_local size_t current_shard;
+
+    shard_runtime_t(const std::vector<int>& cpus, size_t mailbox_capacity, size_t batch)
+        : batch_size(batch)
+        , shards(cpus.size())
+    {
+        for (size_t i = 0; i < shards.size(); i++) {
+            shards[i].cpu = cpus[i];
+            shards[i].inbound.resize(shards.size(), nullptr);
+            shards[i].outbound.resize(shards.size(), nullptr);
+        }
+        for (size_t src = 0; src < shards.size(); src++) {
+            for (size_t dst = 0; dst < shards.size(); dst++) {
+                if (src == dst) {
+                    continue;
+                }
+                mailboxes.push_back(std::make_unique<mailbox_t>(mailbox_capacity));
+                shards[src].outbound[dst] = mailboxes.back().get();
+                shards[dst].inbound[src] = mailboxes.back().get();
+            }
+        }
+    }
+
+    size_t n_shards() const
+    {
+        return shards.size();
+    }
+
+    // returns stage id
+    uint32_t add_stage(size_t shard, Handler handler)
+    {
+        stages.emplace_back(shard, std::move(handler));
+        return stages.size() - 1;
+    }
+
+    void add_poller(size_t shard, Poller poller)
+    {
+        shards[shard].pollers.push_back(std::move(poller));
+    }
+
+    // must be called from shard thread
+    void send(uint32_t stage, const T& msg)
+    {
+        stage_t& dst = stages[stage];
+        dst.counters.on_enqueue();
+        shard_t& me = shards[current_shard];
+        if (dst.shard == current_shard) {
+            me.run_queue.push_back({stage, msg});
+            return;
+        }
+        mailbox_t* mb = me.outbound[dst.shard];
+        if (!mb->overflow.empty() || !mb->ring.try_push({stage, msg})) {
+            mb->overflow.push_back({stage, msg});
+        }
+    }
+
+    void stop()
+    {
+        stopped.store(true, std::memory_order_relaxed);
+    }
+
+    void deliver(envelope_t& e)
+    {
+        stage_t& stage = stages[e.stage];
+        stage.counters.on_dequeue();
+        stage.handler(*this, e.msg);
+    }
+
+    bool poll_once(shard_t& me)
+    {
+        bool busy = false;
+        for (auto& poller : me.pollers) {
+            busy |= poller(*this);
+        }
+        for (mailbox_t* mb : me.inbound) {
+            if (mb != nullptr) {
+                busy |= mb->ring.pop_batch(batch_size, [this](envelope_t& e) { deliver(e); }) > 0;
+            }
+        }
+        // run only messages queued before this point, new ones wait for next iteration
+        for (size_t n = me.run_queue.size(); n > 0; n--) {
+            envelope_t e = std::move(me.run_queue.front());
+            me.run_queue.pop_front();
+            deliver(e);
+            busy = true;
+        }
+        for (mailbox_t* mb : me.outbound) {
+            if (mb == nullptr) {
+                continue;
+            }
+            while (!mb->overflow.empty() && mb->ring.try_push(mb->overflow.front())) {
+                mb->overflow.pop_front();
+            }
+            mb->ring.flush();
+        }
+        return busy;
+    }
+
+    void shard_loop(size_t id)
+    {
+        current_shard = id;
+        shard_t& me = shards[id];
+        if (me.cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(me.cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        size_t idle = 0;
+        while (!stopped.load(std::memory_order_relaxed)) {
+            if (poll_once(me)) {
+                idle = 0;
+            } else if (++idle < 1000) {
+                cpu_pause();
+            } else {
+                // don't starve other threads when cores are oversubscribed
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // runs all shards until stop(), shard 0 runs in calling thread
+    void run()
+    {
+        stopped = false;
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < shards.size(); i++) {
+            threads.emplace_back([this, i]() { shard_loop(i); });
+        }
+        shard_loop(0);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+};
+
+template<typename T, typename Handler, typename Poller>
+thread_local size_t shard_runtime_t<T, Handler, Poller>::current_shard = 0;
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <thread>
+#include <vector>
+
+struct latency_stats_t
+{
+    size_t count = 0;
+    double mean = 0;
+    double stddev = 0;
+    double min = 0;
+    double max = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double p999 = 0;
+};
+
+// Computes stats of samples without full sort: quantiles are found with nth_element
+// on successively smaller tail ranges. Samples are reordered.
+template<typename C>
+latency_stats_t calc_latency_stats(C& samples)
+{
+    latency_stats_t s;
+    s.count = samples.size();
+    if (s.count == 0) {
+        return s;
+    }
+
+    // Welford's online mean and variance
+    double mean = 0;
+    double m2 = 0;
+    size_t n = 0;
+    s.min = s.max = *samples.begin();
+    for (double x : samples) {
+        n++;
+        double delta = x - mean;
+        mean += delta / n;
+        m2 += delta * (x - mean);
+        s.min = std::min(s.min, x);
+        s.max = std::max(s.max, x);
+    }
+    s.mean = mean;
+    s.stddev = std::sqrt(m2 / n);
+
+    auto begin = samples.begin();
+    auto end = samples.end();
+
+    // median, average of two middle elements for even size
+    auto mid = begin + s.count / 2;
+    std::nth_element(begin, mid, end);
+    s.p50 = *mid;
+    if (s.count % 2 == 0) {
+        s.p50 = (s.p50 + *std::max_element(begin, mid)) / 2;
+    }
+
+    // nearest-rank quantiles, every next one is searched right of the previous
+    auto from = mid;
+    for (auto [q, result] : {std::pair{0.9, &s.p90}, std::pair{0.99, &s.p99}, std::pair{0.999, &s.p999}}) {
+        auto nth = begin + std::min<size_t>(s.count - 1, std::ceil(q * s.count) - 1);
+        if (nth < from) {
+            nth = from;
+        }
+        std::nth_element(from, nth, end);
+        *result = *nth;
+        from = nth;
+    }
+    return s;
+}
+
+// Computes stats of every bucket, buckets are distributed between threads.
+template<typename K, typename C>
+std::map<K, latency_stats_t> calc_latency_stats_parallel(std::map<K, C*>& buckets)
+{
+    std::vector<std::pair<K, C*>> jobs(buckets.begin(), buckets.end());
+    std::vector<latency_stats_t> stats(jobs.size());
+    std::atomic<size_t> next_job{0};
+
+    auto worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            stats[i] = calc_latency_stats(*jobs[i].second);
+        }
+    };
+
+    size_t n_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), jobs.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::map<K, latency_stats_t> result;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        result[jobs[i].first] = stats[i];
+    }
+    return result;
+}
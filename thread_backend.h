@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "deadline.h"
+#include "locks.h"
+#include "pipeline.h"
+#include "queue_monitor.h"
+#include "select.h"
+
+using thread_wakeup_t = wakeup_t<std::mutex, std::condition_variable>;
+
+template<typename T, typename Lock = std::mutex>
+struct sync_queue
+{
+    // std::condition_variable works only with std::mutex
+    using cv_type = std::conditional_t<std::is_same_v<Lock, std::mutex>, std::condition_variable,
+                                       std::condition_variable_any>;
+
+    std::queue<T> q;
+    Lock m;
+    cv_type cv;
+    queue_counters_t counters;
+    deadline_filter_t filter;
+    // set by selector_t, notified after every push
+    thread_wakeup_t* wakeup = nullptr;
+
+    void send(T x)
+    {
+        if constexpr (requires { x.set_enqueue_timestamp(std::chrono::high_resolution_clock::now()); }) {
+            if (deadline_policy.needs_enqueue_timestamp()) {
+                x.set_enqueue_timestamp(std::chrono::high_resolution_clock::now());
+            }
+        }
+        std::unique_lock<Lock> lock(m);
+        q.push(x);
+        counters.on_enqueue();
+        cv.notify_one();
+        lock.unlock();
+        if (wakeup) {
+            wakeup->notify();
+        }
+    }
+
+    T pop()
+    {
+        std::unique_lock<Lock> lock(m);
+        if (q.empty()) {
+            cv.wait(lock, [this]() { return !q.empty(); });
+        }
+        auto x = q.front();
+        q.pop();
+        counters.on_dequeue();
+        return x;
+    }
+
+    // expired frames are shed outside of the lock
+    T recv()
+    {
+        while (true) {
+            auto x = pop();
+            if constexpr (requires { x.sheddable(); }) {
+                if (filter.shed(x)) {
+                    continue;
+                }
+            }
+            return x;
+        }
+    }
+
+    // non-blocking recv, for selector_t
+    bool try_recv(T& x)
+    {
+        while (true) {
+            {
+                std::unique_lock<Lock> lock(m);
+                if (q.empty()) {
+                    return false;
+                }
+                x = q.front();
+                q.pop();
+                counters.on_dequeue();
+            }
+            if constexpr (requires { x.sheddable(); }) {
+                if (filter.shed(x)) {
+                    continue;
+                }
+            }
+            return true;
+        }
+    }
+};
+
+// Every stage is an OS thread, queues are sync_queue with given lock type
+template<typename Lock>
+struct thread_backend
+{
+    using queue = sync_queue<msg_t, Lock>;
+    using selector = selector_t<queue, thread_wakeup_t>;
+
+    const bench_config_t& cfg;
+    std::vector<std::thread> threads;
+
+    thread_backend(const bench_config_t& config)
+        : cfg(config)
+    {
+        std::cerr << "backend: threads, lock: " << lock_name<Lock> << std::endl;
+    }
+
+    std::shared_ptr<queue> make_queue()
+    {
+        return std::make_shared<queue>();
+    }
+
+    static void send(queue& q, const msg_t& msg)
+    {
+        q.send(msg);
+    }
+
+    static msg_t recv(queue& q)
+    {
+        return q.recv();
+    }
+
+    static void sleep_for(std::chrono::nanoseconds ns)
+    {
+        std::this_thread::sleep_for(ns);
+    }
+
+    struct pacer
+    {
+        void wait(std::chrono::nanoseconds delay)
+        {
+            using namespace std::chrono_literals;
+            size_t ns = delay.count();
+            if (ns <= 100) {
+                // throuhgput > 10M obj/s
+                return;
+            } else if (ns <= 2000) {
+                // throuhgput > 500k obj/s
+                volatile size_t counter = ns / 2;
+                while (counter) {
+                    counter = counter - 1;
+                }
+            } else if (ns < 100000) {
+                // throuhgput > 10k obj/s
+                auto started = hr_clock::now();
+                while ((hr_clock::now() - started) < delay) { }
+            } else {
+                // throuhgput < 10k obj/s
+                std::this_thread::sleep_for(delay);
+            }
+        }
+    };
+
+    template<typename F>
+    void spawn(F&& f)
+    {
+        int cpu = cfg.cpu_for(threads.size());
+        threads.emplace_back([cpu, f = std::forward<F>(f)]() {
+            pin_current_thread(cpu);
+            f();
+        });
+    }
+
+    void run()
+    {
+        for (auto& t : threads) {
+            t.join();
+        }
+        threads.clear();
+    }
+};